@@ -0,0 +1,99 @@
+#include "HeadlessContext.h"
+#include <EGL/eglext.h>
+#include <gl3w.h>
+#include <stdexcept>
+#include <string.h>
+
+HeadlessContext::HeadlessContext(int width, int height) :
+    display(EGL_NO_DISPLAY),
+    context(EGL_NO_CONTEXT),
+    width(width),
+    height(height),
+    framebufferID(0),
+    colorRenderbufferID(0),
+    depthRenderbufferID(0)
+{
+    //Surfaceless Mesa (llvmpipe included) needs neither a window system nor a GPU
+    auto clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        throw std::runtime_error("Cannot initialize EGL display.");
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configsCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configsCount) || configsCount == 0) {
+        throw std::runtime_error("Cannot find an EGL config with OpenGL support.");
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        throw std::runtime_error("Cannot create an OpenGL 4.3 context.");
+    }
+
+    if (gl3wInit()) {
+        throw std::runtime_error("Cannot load OpenGL functions.");
+    }
+
+    CreateFramebuffer();
+}
+
+void HeadlessContext::CreateFramebuffer()
+{
+    glGenRenderbuffers(1, &colorRenderbufferID);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbufferID);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthRenderbufferID);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbufferID);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebufferID);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbufferID);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbufferID);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Cannot create the offscreen framebuffer.");
+    }
+}
+
+void HeadlessContext::BindFramebuffer()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+    glViewport(0, 0, width, height);
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    glDeleteFramebuffers(1, &framebufferID);
+    glDeleteRenderbuffers(1, &colorRenderbufferID);
+    glDeleteRenderbuffers(1, &depthRenderbufferID);
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+}
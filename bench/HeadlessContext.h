@@ -0,0 +1,28 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <EGL/egl.h>
+#include <stdint.h>
+
+//OpenGL 4.3 core context without a window, rendering into an offscreen framebuffer
+class HeadlessContext
+{
+public:
+    HeadlessContext(int width, int height);
+    HeadlessContext(const HeadlessContext&) = delete;
+    void BindFramebuffer();
+    ~HeadlessContext();
+
+private:
+    EGLDisplay display;
+    EGLContext context;
+    int width;
+    int height;
+    uint32_t framebufferID;
+    uint32_t colorRenderbufferID;
+    uint32_t depthRenderbufferID;
+
+    void CreateFramebuffer();
+};
+
+#endif
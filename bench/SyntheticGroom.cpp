@@ -0,0 +1,83 @@
+#include "SyntheticGroom.h"
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <string>
+
+SyntheticGroom::SyntheticGroom(uint32_t guidesCount, uint32_t segmentsCount, uint32_t trianglesCount) :
+    guidesCount(guidesCount),
+    segmentsCount(segmentsCount),
+    trianglesCount(trianglesCount)
+{
+    const float headRadius = 0.1f;
+    const float strandLength = 0.25f;
+
+    uint32_t columnsCount = (std::max)(2u, (uint32_t)ceilf(sqrtf((float)guidesCount)));
+    uint32_t rowsCount = (std::max)(2u, (guidesCount + columnsCount - 1) / columnsCount);
+    uint32_t verticesPerStrand = segmentsCount + 1;
+
+    positions.reserve((size_t)guidesCount * verticesPerStrand);
+    for (uint32_t guideIndex = 0; guideIndex < guidesCount; guideIndex++) {
+        float u = (float)(guideIndex % columnsCount) / (columnsCount - 1);
+        float v = (float)(guideIndex / columnsCount) / (rowsCount - 1);
+        float azimuth = u * 2.0f * HairGL::PI;
+        float elevation = (0.1f + 0.8f * v) * 0.5f * HairGL::PI;
+
+        HairGL::Vector3 normal(cosf(elevation) * cosf(azimuth), sinf(elevation), cosf(elevation) * sinf(azimuth));
+        auto root = normal * headRadius;
+
+        for (uint32_t i = 0; i < verticesPerStrand; i++) {
+            float t = (float)i / segmentsCount;
+            auto position = root + normal * (strandLength * 0.3f * t) - HairGL::Vector3(0, strandLength * t * t, 0);
+            positions.push_back(HairGL::Vector4(position.x, position.y, position.z, i == 0 ? 0.0f : 1.0f));
+        }
+    }
+
+    //Two triangles per grid cell, repeated when more triangles than cells are requested
+    std::vector<int32_t> gridTriangles;
+    for (uint32_t row = 0; row + 1 < rowsCount; row++) {
+        for (uint32_t column = 0; column + 1 < columnsCount; column++) {
+            int32_t i0 = row * columnsCount + column;
+            int32_t i1 = i0 + 1;
+            int32_t i2 = i0 + columnsCount;
+            int32_t i3 = i2 + 1;
+            if ((uint32_t)i3 >= guidesCount) {
+                continue;
+            }
+            gridTriangles.insert(gridTriangles.end(), { i0, i1, i2, i1, i3, i2 });
+        }
+    }
+
+    if (gridTriangles.empty()) {
+        throw std::runtime_error("Synthetic groom needs at least four guides.");
+    }
+
+    triangles.resize((size_t)trianglesCount * 3);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        triangles[i] = gridTriangles[i % gridTriangles.size()];
+    }
+}
+
+void SyntheticGroom::WriteVersion1(const char* path) const
+{
+    auto file = fopen(path, "wb");
+    if (file == nullptr) {
+        throw std::runtime_error(std::string("Cannot open file ") + path);
+    }
+
+    int32_t counts[3] = { (int32_t)guidesCount, (int32_t)segmentsCount, (int32_t)trianglesCount };
+    fwrite(counts, sizeof(counts), 1, file);
+
+    for (auto& position : positions) {
+        fwrite(position.m, sizeof(float), 3, file);
+    }
+    fwrite(triangles.data(), sizeof(int32_t), triangles.size(), file);
+
+    bool failed = ferror(file) != 0;
+    fclose(file);
+
+    if (failed) {
+        throw std::runtime_error(std::string("Cannot write file ") + path);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef SYNTHETIC_GROOM_H
+#define SYNTHETIC_GROOM_H
+
+#include <hairgl/Math.h>
+#include <stdint.h>
+#include <vector>
+
+//Guides grown from a grid on the upper half of a head sized sphere, with the growth mesh
+//triangulating that grid
+struct SyntheticGroom
+{
+    uint32_t guidesCount;
+    uint32_t segmentsCount;
+    uint32_t trianglesCount;
+    std::vector<HairGL::Vector4> positions;
+    std::vector<int32_t> triangles;
+
+    SyntheticGroom(uint32_t guidesCount, uint32_t segmentsCount, uint32_t trianglesCount);
+    void WriteVersion1(const char* path) const;
+};
+
+#endif
@@ -0,0 +1,521 @@
+#include "HeadlessContext.h"
+#include "SyntheticGroom.h"
+#include <hairgl/HairGL.h>
+#include <gl3w.h>
+#include "HairAssetFile.h"
+#include "ThreadPool.h"
+#include "Common.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct BenchmarkOptions
+{
+    uint32_t guidesCount = 4096;
+    uint32_t segmentsCount = 15;
+    uint32_t trianglesCount = 0;
+    uint32_t instancesCount = 1;
+    uint32_t framesCount = 100;
+    int width = 1280;
+    int height = 720;
+    HairGL::SimulationBackend backend = HairGL::SimulationBackend::GPU;
+    HairGL::HairRenderingPipeline pipeline = HairGL::HairRenderingPipeline::Tesselation;
+    std::string assetPath = "hairgl_bench_groom.hgl";
+    std::string programCacheDirectory;
+    bool compactStorage = false;
+    bool followStrandsCache = false;
+    uint32_t collidersCount = 0;
+    float interaction = 0.0f;
+    bool compareBackends = false;
+};
+
+//Largest difference of a simulated coordinate between the backends --compare-backends accepts. Both
+//run the same steps in single precision and differ only by rounding, which one step from the same
+//state always keeps below this.
+constexpr float BackendsMaxError = 1e-4f;
+//Over many steps strands buckling against colliders or pushed around by interaction amplify any
+//difference, whichever backend it comes from. A GPU run offset by BackendsPerturbation measures that
+//amplification, and runs on different backends may drift apart up to BackendsDriftFactor times as far.
+constexpr float BackendsPerturbation = 1e-6f;
+constexpr float BackendsDriftFactor = 4.0f;
+
+struct TimingStats
+{
+    double meanMs;
+    double minMs;
+    double maxMs;
+    double medianMs;
+    double p95Ms;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double ElapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+TimingStats CalculateStats(std::vector<double> samples)
+{
+    TimingStats stats = {};
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    for (auto sample : samples) {
+        stats.meanMs += sample;
+    }
+    stats.meanMs /= samples.size();
+    stats.minMs = samples.front();
+    stats.maxMs = samples.back();
+    stats.medianMs = samples[samples.size() / 2];
+    stats.p95Ms = samples[(std::min)(samples.size() - 1, samples.size() * 95 / 100)];
+    return stats;
+}
+
+void PrintStats(FILE* output, const char* name, const TimingStats& stats, bool last = false)
+{
+    fprintf(output, "    \"%s\": { \"mean_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, \"median_ms\": %.4f, \"p95_ms\": %.4f }%s\n",
+        name, stats.meanMs, stats.minMs, stats.maxMs, stats.medianMs, stats.p95Ms, last ? "" : ",");
+}
+
+std::string EscapeJson(const char* text)
+{
+    std::string escaped;
+    for (auto c = text; c && *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            escaped += '\\';
+        }
+        escaped += *c;
+    }
+    return escaped;
+}
+
+void PrintUsage()
+{
+    std::cerr << "Usage: hairgl_bench [--guides N] [--segments N] [--triangles N] [--instances N] [--frames N]" << std::endl;
+    std::cerr << "                    [--width N] [--height N] [--backend gpu|cpu] [--pipeline tess|compute]" << std::endl;
+    std::cerr << "                    [--asset PATH] [--program-cache DIRECTORY] [--storage full|compact]" << std::endl;
+    std::cerr << "                    [--colliders N] [--interaction STRENGTH] [--follow-strands cache|direct]" << std::endl;
+    std::cerr << "                    [--compare-backends]" << std::endl;
+}
+
+bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        if (name == "--compare-backends") {
+            options.compareBackends = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (name == "--guides") {
+            options.guidesCount = strtoul(value, nullptr, 10);
+        }
+        else if (name == "--segments") {
+            options.segmentsCount = strtoul(value, nullptr, 10);
+        }
+        else if (name == "--triangles") {
+            options.trianglesCount = strtoul(value, nullptr, 10);
+        }
+        else if (name == "--instances") {
+            options.instancesCount = strtoul(value, nullptr, 10);
+        }
+        else if (name == "--frames") {
+            options.framesCount = strtoul(value, nullptr, 10);
+        }
+        else if (name == "--width") {
+            options.width = atoi(value);
+        }
+        else if (name == "--height") {
+            options.height = atoi(value);
+        }
+        else if (name == "--backend") {
+            options.backend = strcmp(value, "cpu") == 0 ? HairGL::SimulationBackend::CPU : HairGL::SimulationBackend::GPU;
+        }
+        else if (name == "--pipeline") {
+            options.pipeline = strcmp(value, "compute") == 0 ? HairGL::HairRenderingPipeline::Compute : HairGL::HairRenderingPipeline::Tesselation;
+        }
+        else if (name == "--asset") {
+            options.assetPath = value;
+        }
+        else if (name == "--program-cache") {
+            options.programCacheDirectory = value;
+        }
+        else if (name == "--storage") {
+            options.compactStorage = strcmp(value, "compact") == 0;
+        }
+        else if (name == "--colliders") {
+            options.collidersCount = strtoul(value, nullptr, 10);
+        }
+        else if (name == "--interaction") {
+            options.interaction = (float)atof(value);
+        }
+        else if (name == "--follow-strands") {
+            options.followStrandsCache = strcmp(value, "cache") == 0;
+        }
+        else {
+            return false;
+        }
+    }
+
+    if (options.trianglesCount == 0) {
+        options.trianglesCount = options.guidesCount * 2;
+    }
+
+    return options.guidesCount >= 4 && options.segmentsCount >= 1 && options.instancesCount >= 1;
+}
+
+//A head sphere under the roots of the synthetic groom, then capsules around the neck and shoulders
+std::vector<HairGL::HairCollider> CreateColliders(uint32_t count)
+{
+    std::vector<HairGL::HairCollider> colliders;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i == 0) {
+            colliders.push_back(HairGL::HairCollider::Sphere(HairGL::Vector3(0.0f, 0.0f, 0.0f), 0.1f));
+            continue;
+        }
+
+        float angle = 2.0f * HairGL::PI * i / count;
+        HairGL::Vector3 direction(cosf(angle), 0.0f, sinf(angle));
+        auto start = direction * 0.05f + HairGL::Vector3(0.0f, -0.15f, 0.0f);
+        auto end = direction * 0.2f + HairGL::Vector3(0.0f, -0.2f, 0.0f);
+        colliders.push_back(HairGL::HairCollider::Capsule(start, end, 0.03f));
+    }
+    return colliders;
+}
+
+HairGL::HairInstanceSettings CreateInstanceSettings(const BenchmarkOptions& options)
+{
+    HairGL::HairInstanceSettings settings;
+    settings.simulationBackend = options.backend;
+    settings.globalStiffness = 0.05f;
+    settings.localStiffness = 0.5f;
+    settings.damping = 0.05f;
+    settings.wind = HairGL::Vector3(5.0f, 0.0f, 0.0f);
+    settings.volumeStiffness = options.interaction;
+    settings.hairFriction = options.interaction;
+    return settings;
+}
+
+std::vector<HairGL::Vector4> ReadPositions(const HairGL::HairInstance* instance)
+{
+    std::vector<HairGL::Vector4> positions(HairGL::GetPositionsSize(instance) / sizeof(HairGL::Vector4));
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, HairGL::GetPositionsBufferID(instance));
+    glGetBufferSubData(GL_COPY_READ_BUFFER, HairGL::GetPositionsOffset(instance), HairGL::GetPositionsSize(instance), positions.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return positions;
+}
+
+float GetMaxError(const std::vector<HairGL::Vector4>& positions, const std::vector<HairGL::Vector4>& reference)
+{
+    float maxError = 0.0f;
+    for (size_t i = 0; i < positions.size(); i++) {
+        for (int k = 0; k < 3; k++) {
+            float error = fabsf(positions[i].m[k] - reference[i].m[k]);
+            maxError = std::isnan(error) ? INFINITY : (std::max)(maxError, error);
+        }
+    }
+    return maxError;
+}
+
+//Current and previous positions, so the destination continues exactly like the source
+void CopyPositions(const HairGL::HairInstance* source, HairGL::HairInstance* destination)
+{
+    size_t size = HairGL::GetPositionsSize(source);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, HairGL::GetPositionsBufferID(source));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, HairGL::GetPositionsBufferID(destination));
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, HairGL::GetPositionsOffset(source), HairGL::GetPositionsOffset(destination), size);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, HairGL::GetPreviousPositionsBufferID(source));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, HairGL::GetPreviousPositionsBufferID(destination));
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, HairGL::GetPositionsOffset(source), HairGL::GetPositionsOffset(destination), size);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void PerturbPositions(HairGL::HairInstance* instance, float offset)
+{
+    auto positions = ReadPositions(instance);
+    for (auto& position : positions) {
+        if (position.w > 0) {
+            position.x += offset;
+        }
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, HairGL::GetPositionsBufferID(instance));
+    glBufferSubData(GL_COPY_WRITE_BUFFER, HairGL::GetPositionsOffset(instance), HairGL::GetPositionsSize(instance), positions.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+//Steps the same instance on the GPU, on the CPU and on the GPU for the first half of the frames then
+//on the CPU. Every other frame one more instance takes a CPU step from the state of the GPU one, which
+//must match it within BackendsMaxError. The free running CPU instances must stay within BackendsMaxError
+//of the GPU, or within BackendsDriftFactor times the drift of a perturbed GPU run where that is larger.
+int CompareBackends(const BenchmarkOptions& options, HairGL::HairSystem& hairSystem)
+{
+    auto settings = CreateInstanceSettings(options);
+    settings.simulationBackend = HairGL::SimulationBackend::GPU;
+    auto asset = hairSystem.LoadAsset(options.assetPath.c_str());
+    auto colliders = CreateColliders(options.collidersCount);
+
+    HairGL::HairInstance* instances[5];
+    for (auto& instance : instances) {
+        instance = hairSystem.CreateInstance(asset);
+        hairSystem.UpdateInstanceSettings(instance, settings);
+        hairSystem.UpdateInstanceColliders(instance, colliders.data(), colliders.size());
+    }
+    auto gpuInstance = instances[0];
+    auto cpuInstance = instances[1];
+    auto switchedInstance = instances[2];
+    auto stepInstance = instances[3];
+    auto perturbedInstance = instances[4];
+
+    auto cpuSettings = settings;
+    cpuSettings.simulationBackend = HairGL::SimulationBackend::CPU;
+    hairSystem.UpdateInstanceSettings(cpuInstance, cpuSettings);
+    PerturbPositions(perturbedInstance, BackendsPerturbation);
+
+    float stepError = 0.0f;
+    for (uint32_t frame = 0; frame < options.framesCount; frame++) {
+        if (frame == options.framesCount / 2) {
+            hairSystem.UpdateInstanceSettings(switchedInstance, cpuSettings);
+        }
+
+        //A GPU step from the state of the GPU instance leaves both equal, the CPU step after it
+        //starts from positions read back from the GPU
+        bool cpuStep = frame % 2 == 1;
+        if (cpuStep) {
+            hairSystem.UpdateInstanceSettings(stepInstance, cpuSettings);
+        }
+        else {
+            CopyPositions(gpuInstance, stepInstance);
+        }
+
+        hairSystem.Simulate(instances, 5);
+
+        if (cpuStep) {
+            stepError = (std::max)(stepError, GetMaxError(ReadPositions(stepInstance), ReadPositions(gpuInstance)));
+            hairSystem.UpdateInstanceSettings(stepInstance, settings);
+        }
+    }
+
+    auto gpuPositions = ReadPositions(gpuInstance);
+    float cpuError = GetMaxError(ReadPositions(cpuInstance), gpuPositions);
+    float switchedError = GetMaxError(ReadPositions(switchedInstance), gpuPositions);
+    float perturbedError = GetMaxError(ReadPositions(perturbedInstance), gpuPositions);
+    float driftTolerance = (std::max)(BackendsMaxError, BackendsDriftFactor * perturbedError);
+
+    for (auto instance : instances) {
+        hairSystem.DestroyInstance(instance);
+    }
+    hairSystem.DestroyAsset(asset);
+    remove(options.assetPath.c_str());
+
+    bool passed = stepError <= BackendsMaxError && cpuError <= driftTolerance && switchedError <= driftTolerance;
+    FILE* output = stdout;
+    fprintf(output, "{\n");
+    fprintf(output, "  \"config\": { \"guides\": %u, \"segments\": %u, \"frames\": %u, \"colliders\": %u, \"interaction\": %.3f },\n",
+        options.guidesCount, options.segmentsCount, options.framesCount, options.collidersCount, options.interaction);
+    fprintf(output, "  \"results\": {\n");
+    fprintf(output, "    \"step_max_error\": %g,\n", stepError);
+    fprintf(output, "    \"step_tolerance\": %g,\n", BackendsMaxError);
+    fprintf(output, "    \"cpu_max_error\": %g,\n", cpuError);
+    fprintf(output, "    \"switched_max_error\": %g,\n", switchedError);
+    fprintf(output, "    \"perturbed_gpu_max_error\": %g,\n", perturbedError);
+    fprintf(output, "    \"tolerance\": %g,\n", driftTolerance);
+    fprintf(output, "    \"passed\": %s\n", passed ? "true" : "false");
+    fprintf(output, "  }\n");
+    fprintf(output, "}\n");
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return -1;
+    }
+
+    try {
+        HeadlessContext context(options.width, options.height);
+
+        auto start = Clock::now();
+        HairGL::HairSystemSettings systemSettings;
+        systemSettings.renderingPipeline = options.pipeline;
+        systemSettings.programCacheDirectory = options.programCacheDirectory;
+        systemSettings.compactStorage = options.compactStorage;
+        systemSettings.followStrandsCache = options.followStrandsCache;
+        HairGL::HairSystem hairSystem(systemSettings);
+        double createSystemMs = ElapsedMs(start);
+
+        SyntheticGroom groom(options.guidesCount, options.segmentsCount, options.trianglesCount);
+        groom.WriteVersion1(options.assetPath.c_str());
+        if (options.compareBackends) {
+            return CompareBackends(options, hairSystem);
+        }
+
+        //Constraint precomputation on its own, as version 1 loading runs it
+        size_t verticesCount = groom.positions.size();
+        std::vector<HairGL::Vector4> tangentsDistances(verticesCount);
+        std::vector<HairGL::Vector4> refVectors(verticesCount);
+        std::vector<HairGL::Quaternion> globalRotations(verticesCount);
+        HairGL::StridedPositions positions = { reinterpret_cast<const uint8_t*>(groom.positions.data()), sizeof(HairGL::Vector4) };
+
+        start = Clock::now();
+        HairGL::CalculateConstraints(positions, groom.guidesCount, groom.segmentsCount + 1, tangentsDistances.data());
+        double calculateConstraintsMs = ElapsedMs(start);
+
+        start = Clock::now();
+        HairGL::CalculateRotations(positions, groom.guidesCount, groom.segmentsCount + 1, globalRotations.data(), refVectors.data());
+        double calculateRotationsMs = ElapsedMs(start);
+
+        //Same precomputation spread over a pool, as LoadAsset and the loader thread run it
+        HairGL::ThreadPool threadPool;
+        start = Clock::now();
+        HairGL::CalculateConstraints(positions, groom.guidesCount, groom.segmentsCount + 1, tangentsDistances.data(), &threadPool);
+        double calculateConstraintsParallelMs = ElapsedMs(start);
+
+        start = Clock::now();
+        HairGL::CalculateRotations(positions, groom.guidesCount, groom.segmentsCount + 1, globalRotations.data(), refVectors.data(), &threadPool);
+        double calculateRotationsParallelMs = ElapsedMs(start);
+
+        start = Clock::now();
+        auto asset = hairSystem.LoadAsset(options.assetPath.c_str());
+        glFinish();
+        double loadVersion1Ms = ElapsedMs(start);
+
+        std::string version2Path = options.assetPath + ".v2";
+        hairSystem.SaveAsset(asset, version2Path.c_str());
+        hairSystem.DestroyAsset(asset);
+
+        start = Clock::now();
+        asset = hairSystem.LoadAsset(version2Path.c_str());
+        glFinish();
+        double loadVersion2Ms = ElapsedMs(start);
+
+        //Asynchronous version 1 load, the longest EndFrame call is the hitch a frame would see
+        start = Clock::now();
+        auto assetLoad = hairSystem.LoadAssetAsync(options.assetPath.c_str());
+        double loadAsyncMaxFrameMs = 0.0;
+        uint32_t loadAsyncFramesCount = 0;
+        while (hairSystem.GetAssetLoadState(assetLoad) == HairGL::HairAssetLoadState::Loading ||
+            hairSystem.GetAssetLoadState(assetLoad) == HairGL::HairAssetLoadState::Uploading) {
+            auto frameStart = Clock::now();
+            hairSystem.EndFrame();
+            glFinish();
+            double frameMs = ElapsedMs(frameStart);
+            loadAsyncMaxFrameMs = (std::max)(loadAsyncMaxFrameMs, frameMs);
+            loadAsyncFramesCount++;
+        }
+        hairSystem.DestroyAsset(hairSystem.FinishAssetLoad(assetLoad));
+        double loadAsyncMs = ElapsedMs(start);
+
+        remove(options.assetPath.c_str());
+        remove(version2Path.c_str());
+
+        auto settings = CreateInstanceSettings(options);
+        auto colliders = CreateColliders(options.collidersCount);
+
+        std::vector<HairGL::HairInstance*> instances;
+        for (uint32_t i = 0; i < options.instancesCount; i++) {
+            auto instance = hairSystem.CreateInstance(asset);
+            settings.modelMatrix = HairGL::Matrix4::Translation(0.3f * (i % 8), 0.0f, -0.3f * (i / 8));
+            hairSystem.UpdateInstanceSettings(instance, settings);
+            instances.push_back(instance);
+        }
+
+        auto viewMatrix = HairGL::Matrix4::LookAt(HairGL::Vector3(0.0f, 0.1f, 0.6f), HairGL::Vector3(0.0f, 0.0f, 0.0f), HairGL::Vector3(0, 1, 0));
+        auto projectionMatrix = HairGL::Matrix4::Perspective(HairGL::DegToRad * 60.0f, (float)options.width / options.height, 0.01f, 100.0f);
+        std::vector<const HairGL::HairInstance*> renderedInstances(instances.begin(), instances.end());
+
+        context.BindFramebuffer();
+        hairSystem.SetFrameStatsEnabled(true);
+
+        std::vector<double> simulateSamples;
+        std::vector<double> renderSamples;
+        std::vector<double> simulateGPUSamples;
+        std::vector<double> hairGPUSamples;
+        uint64_t nextStatsFrame = 0;
+        for (uint32_t frame = 0; frame < options.framesCount; frame++) {
+            start = Clock::now();
+            for (auto instance : instances) {
+                hairSystem.UpdateInstanceColliders(instance, colliders.data(), colliders.size());
+            }
+            hairSystem.Simulate(instances.data(), instances.size());
+            glFinish();
+            simulateSamples.push_back(ElapsedMs(start));
+
+            start = Clock::now();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            hairSystem.Render(renderedInstances.data(), renderedInstances.size(), viewMatrix, projectionMatrix);
+            glFinish();
+            renderSamples.push_back(ElapsedMs(start));
+
+            hairSystem.EndFrame();
+            auto& frameStats = hairSystem.GetFrameStats();
+            if (frameStats.frameIndex >= nextStatsFrame) {
+                simulateGPUSamples.push_back(frameStats.simulationGPUTime);
+                hairGPUSamples.push_back(frameStats.hairGPUTime);
+                nextStatsFrame = frameStats.frameIndex + 1;
+            }
+        }
+
+        for (auto instance : instances) {
+            hairSystem.DestroyInstance(instance);
+        }
+        hairSystem.DestroyAsset(asset);
+
+        FILE* output = stdout;
+        fprintf(output, "{\n");
+        fprintf(output, "  \"device\": { \"vendor\": \"%s\", \"renderer\": \"%s\", \"version\": \"%s\" },\n",
+            EscapeJson((const char*)glGetString(GL_VENDOR)).c_str(),
+            EscapeJson((const char*)glGetString(GL_RENDERER)).c_str(),
+            EscapeJson((const char*)glGetString(GL_VERSION)).c_str());
+        fprintf(output, "  \"config\": { \"guides\": %u, \"segments\": %u, \"triangles\": %u, \"instances\": %u, \"frames\": %u, \"width\": %d, \"height\": %d, \"backend\": \"%s\", \"pipeline\": \"%s\", \"storage\": \"%s\", \"colliders\": %u, \"interaction\": %.3f, \"follow_strands\": \"%s\" },\n",
+            options.guidesCount, options.segmentsCount, options.trianglesCount, options.instancesCount, options.framesCount,
+            options.width, options.height, options.backend == HairGL::SimulationBackend::CPU ? "cpu" : "gpu",
+            options.pipeline == HairGL::HairRenderingPipeline::Compute ? "compute" : "tess",
+            options.compactStorage ? "compact" : "full", options.collidersCount, options.interaction,
+            options.followStrandsCache ? "cache" : "direct");
+        fprintf(output, "  \"results\": {\n");
+        fprintf(output, "    \"create_system_ms\": %.4f,\n", createSystemMs);
+        fprintf(output, "    \"calculate_constraints_ms\": %.4f,\n", calculateConstraintsMs);
+        fprintf(output, "    \"calculate_rotations_ms\": %.4f,\n", calculateRotationsMs);
+        fprintf(output, "    \"calculate_constraints_parallel_ms\": %.4f,\n", calculateConstraintsParallelMs);
+        fprintf(output, "    \"calculate_rotations_parallel_ms\": %.4f,\n", calculateRotationsParallelMs);
+        fprintf(output, "    \"load_asset_v1_ms\": %.4f,\n", loadVersion1Ms);
+        fprintf(output, "    \"load_asset_v2_ms\": %.4f,\n", loadVersion2Ms);
+        fprintf(output, "    \"load_asset_async_ms\": %.4f,\n", loadAsyncMs);
+        fprintf(output, "    \"load_asset_async_frames\": %u,\n", loadAsyncFramesCount);
+        fprintf(output, "    \"load_asset_async_max_frame_ms\": %.4f,\n", loadAsyncMaxFrameMs);
+        PrintStats(output, "simulate", CalculateStats(simulateSamples));
+        PrintStats(output, "render", CalculateStats(renderSamples));
+        PrintStats(output, "simulate_gpu", CalculateStats(simulateGPUSamples));
+        PrintStats(output, "hair_gpu", CalculateStats(hairGPUSamples), true);
+        fprintf(output, "  }\n");
+        fprintf(output, "}\n");
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -4,29 +4,54 @@
 #include "Math.h"
 #include "HairTypes.h"
 #include <stdint.h>
+#include <stddef.h>
 
 namespace HairGL
 {
     class Renderer;
+    class ThreadPool;
+    class CPUSimulator;
+    class FrameProfiler;
     class HairAsset;
     class HairInstance;
+    class HairAssetLoad;
+    class AssetLoader;
+    class AssetCache;
 
     class HairSystem
     {
     public:
-        HairSystem();
+        explicit HairSystem(const HairSystemSettings& settings = HairSystemSettings());
         HairSystem(const HairSystem&) = delete;
         void Simulate(HairInstance* instance, float timeStep = 1.0f / 60.0f) const;
+        void Simulate(HairInstance* const* instances, size_t count, float timeStep = 1.0f / 60.0f) const;
+        uint32_t Advance(HairInstance* instance, float frameTime) const;
+        uint32_t Advance(HairInstance* const* instances, size_t count, float frameTime) const;
         void Render(const HairInstance* instance, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const;
+        void Render(const HairInstance* const* instances, size_t count, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const;
         HairAsset* LoadAsset(const char* path) const;
+        HairAssetLoad* LoadAssetAsync(const char* path) const;
+        HairAssetLoadState GetAssetLoadState(const HairAssetLoad* load) const;
+        HairAsset* FinishAssetLoad(HairAssetLoad* load) const;
+        void SaveAsset(const HairAsset* asset, const char* path) const;
         void DestroyAsset(HairAsset* asset) const;
         HairInstance* CreateInstance(const HairAsset* asset) const;
         void UpdateInstanceSettings(HairInstance* instance, const HairInstanceSettings& settings) const;
+        void UpdateInstanceColliders(HairInstance* instance, const HairCollider* colliders, size_t count) const;
         void DestroyInstance(HairInstance* instance) const;
+        void SetFrameStatsEnabled(bool enabled) const;
+        void EndFrame() const;
+        const HairFrameStats& GetFrameStats() const;
         ~HairSystem();
 
     private:
+        HairSystemSettings settings;
         Renderer* renderer;
+        ThreadPool* threadPool;
+        CPUSimulator* cpuSimulator;
+        FrameProfiler* profiler;
+        AssetLoader* assetLoader;
+        AssetCache* assetCache;
     };
 }
 
@@ -3,9 +3,13 @@
 
 #include <stdint.h>
 #include <hairgl/Math.h>
+#include <string>
+#include <vector>
 
 namespace HairGL
 {
+    class HairInstance;
+
     struct HairAssetDescriptor
     {
         uint32_t segmentsCount;
@@ -13,6 +17,67 @@ namespace HairGL
         Vector4* positions;
     };
 
+    enum class SimulationBackend
+    {
+        GPU,
+        CPU
+    };
+
+    enum class HairRenderingPipeline
+    {
+        //Strands are generated by the tesselator and expanded into ribbons by a geometry shader
+        Tesselation,
+        //A compute pass writes camera facing ribbons that an indexed draw renders
+        Compute
+    };
+
+    enum class HairAssetLoadState
+    {
+        Loading,
+        Uploading,
+        Ready,
+        Failed
+    };
+
+    struct HairSystemSettings
+    {
+        //Longest strand, in vertices, the GPU simulation accepts. Assets with longer strands fail to load.
+        uint32_t maxStrandVertices;
+        HairRenderingPipeline renderingPipeline;
+        //Existing directory where linked programs are kept between runs, empty to always compile from source
+        std::string programCacheDirectory;
+        //Shaders found in this directory replace the ones built into the library, empty to use only the built in ones
+        std::string shaderOverrideDirectory;
+        //Step HairSystem::Advance simulates with, and the most steps it runs for one frame
+        float fixedTimeStep;
+        uint32_t maxSubsteps;
+        //Bytes of asynchronously loaded assets copied to the GPU by each EndFrame call
+        size_t assetUploadBudget;
+        //Keeps rest data of assets as 16-bit values, halving what the simulation reads per vertex
+        //at the cost of precision. Simulated positions stay 32-bit floats.
+        bool compactStorage;
+        //Cells along each axis of the grid hair-hair interaction is solved on. Splatting and applying
+        //it is linear in the vertices, clearing it in the cells.
+        uint32_t interactionGridResolution;
+        //Interpolates the strands of the visible triangles once per frame in a compute pass, so hair
+        //rendering reads them instead of interpolating every point from the guides again. Off by default,
+        //the buffer needs room for every strand of the largest instance at full density, 32 bytes per
+        //vertex, which reaches hundreds of megabytes for dense grooms.
+        bool followStrandsCache;
+
+        HairSystemSettings() :
+            maxStrandVertices(64),
+            renderingPipeline(HairRenderingPipeline::Tesselation),
+            fixedTimeStep(1.0f / 60.0f),
+            maxSubsteps(4),
+            assetUploadBudget(4 * 1024 * 1024),
+            compactStorage(false),
+            interactionGridResolution(32),
+            followStrandsCache(false)
+        {
+        }
+    };
+
     struct HairInstanceSettings
     {
         //GLOBAL
@@ -23,6 +88,14 @@ namespace HairGL
         float tesselationFactor;
         float density;
 
+        //LOD
+        //Density and tesselation fall from the values above towards the minimums as a growth mesh
+        //triangle covers less than lodFullDetailSize pixels. Strands get wider to keep the coverage.
+        bool lodEnabled;
+        float lodMinDensity;
+        float lodMinTesselationFactor;
+        float lodFullDetailSize;
+
         //SHAPE
         float rootWidth;
         float tipWidth;
@@ -40,6 +113,13 @@ namespace HairGL
 		float localStiffness;
         float damping;
 		Vector3 wind;
+        SimulationBackend simulationBackend;
+
+        //HAIR INTERACTION
+        //Strands push apart where the grid is denser and move towards the average velocity of their
+        //neighbours. The grid pass is skipped while both are zero.
+        float volumeStiffness;
+        float hairFriction;
 
         HairInstanceSettings() :
             visualizeGuides(false),
@@ -47,6 +127,10 @@ namespace HairGL
             renderHair(true),
             tesselationFactor(1.0f),
             density(16.0f),
+            lodEnabled(false),
+            lodMinDensity(1.0f),
+            lodMinTesselationFactor(1.0f),
+            lodFullDetailSize(32.0f),
             rootWidth(0.001f),
             tipWidth(0.0005f),
             thinningStart(0.5f),
@@ -58,11 +142,72 @@ namespace HairGL
             globalStiffness(0),
 			localStiffness(0),
             damping(0),
-			wind(0, 0, 0)
+			wind(0, 0, 0),
+            simulationBackend(SimulationBackend::GPU),
+            volumeStiffness(0),
+            hairFriction(0)
         {
             modelMatrix.SetIdentity();
         }
     };
+
+    //Sphere or capsule the simulated hair is pushed out of, in the space of the asset. A sphere
+    //is a capsule whose ends are the same point.
+    struct HairCollider
+    {
+        Vector3 start;
+        Vector3 end;
+        float radius;
+
+        HairCollider() :
+            radius(0.0f)
+        {
+        }
+
+        HairCollider(const Vector3& start, const Vector3& end, float radius) :
+            start(start),
+            end(end),
+            radius(radius)
+        {
+        }
+
+        static HairCollider Sphere(const Vector3& center, float radius)
+        {
+            return HairCollider(center, center, radius);
+        }
+
+        static HairCollider Capsule(const Vector3& start, const Vector3& end, float radius)
+        {
+            return HairCollider(start, end, radius);
+        }
+    };
+
+    //Times are in milliseconds. GPU time of a simulation dispatch is split evenly between
+    //the instances it simulated.
+    struct HairInstanceStats
+    {
+        const HairInstance* instance;
+        double simulationCPUTime;
+        double simulationGPUTime;
+        double renderCPUTime;
+        double cullingGPUTime;
+        double guidesGPUTime;
+        double growthMeshGPUTime;
+        double hairGPUTime;
+    };
+
+    struct HairFrameStats
+    {
+        uint64_t frameIndex;
+        double simulationCPUTime;
+        double simulationGPUTime;
+        double renderCPUTime;
+        double cullingGPUTime;
+        double guidesGPUTime;
+        double growthMeshGPUTime;
+        double hairGPUTime;
+        std::vector<HairInstanceStats> instances;
+    };
 }
 
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef HAIRGL_MATH_H
 #define HAIRGL_MATH_H
 
+#include <stddef.h>
+
 namespace HairGL
 {
     constexpr float PI = 3.1415926535f;
@@ -145,7 +147,10 @@ namespace HairGL
         Matrix4 EuclidianInversed() const;
         
         Matrix4 operator*(const Matrix4& other) const;
+        //Dot products of v with the four stored vectors, i.e. transpose(M) * v for column-major storage
         Vector4 operator*(const Vector4& v) const;
+        //M * v for column-major storage, as in GLSL and TransformVectors
+        Vector4 Transform(const Vector4& v) const;
     };
 
 	struct Matrix3
@@ -203,6 +208,37 @@ namespace HairGL
 		Vector3 operator*(const Vector3& v) const;
 		Quaternion operator*(const Quaternion& other) const;
 	};
+
+    //Vectors or quaternions stored as a structure of arrays. The batch functions below loop over
+    //the lanes of whole blocks, which optimized builds vectorize for the target: SSE2 by default on
+    //x86-64, AVX only with an explicit -march (see HAIRGL_NATIVE_ARCH), NEON on aarch64.
+    constexpr size_t Vector4BlockSize = 8;
+
+    struct Vector4Block
+    {
+        float x[Vector4BlockSize];
+        float y[Vector4BlockSize];
+        float z[Vector4BlockSize];
+        float w[Vector4BlockSize];
+    };
+
+    //At most Vector4BlockSize vectors, lanes past count are loaded as zero and not stored
+    void LoadBlock(const Vector4* vectors, size_t count, Vector4Block& block);
+    void StoreBlock(const Vector4Block& block, size_t count, Vector4* vectors);
+    void LoadBlock(const Quaternion* quaternions, size_t count, Vector4Block& block);
+    void StoreBlock(const Vector4Block& block, size_t count, Quaternion* quaternions);
+
+    void TransformBlocks(const Matrix4& matrix, const Vector4Block* input, Vector4Block* output, size_t blocksCount);
+    //Rotates xyz, w is copied
+    void RotateBlocks(const Quaternion& rotation, const Vector4Block* input, Vector4Block* output, size_t blocksCount);
+    void MultiplyQuaternionBlocks(const Vector4Block* a, const Vector4Block* b, Vector4Block* output, size_t blocksCount);
+    //All four components, so quaternion blocks can be normalized as well
+    void NormalizeBlocks(Vector4Block* blocks, size_t blocksCount);
+
+    //Array versions going through blocks, input and output may be the same array
+    void TransformVectors(const Matrix4& matrix, const Vector4* input, Vector4* output, size_t count);
+    void RotateVectors(const Quaternion& rotation, const Vector4* input, Vector4* output, size_t count);
+    void NormalizeVectors(Vector4* vectors, size_t count);
 }
 
 #endif
\ No newline at end of file
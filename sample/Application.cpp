@@ -20,6 +20,7 @@ Application::Application(const char* windowTitle, int initialScreenWidth, int in
     glfwMakeContextCurrent(window);
     
     hairSystem = new HairGL::HairSystem();
+    hairSystem->SetFrameStatsEnabled(true);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -44,14 +45,19 @@ void Application::Run()
 {
     glfwShowWindow(window);
 
+    double frameStart = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
-        Update(1.0f / 60.0f);
+
+        double now = glfwGetTime();
+        Update((float)(now - frameStart));
+        frameStart = now;
+
         Render();
     }
 }
 
-void Application::Update(float timeStep)
+void Application::Update(float frameTime)
 {
     cameraController->Update();
 
@@ -65,7 +71,7 @@ void Application::Update(float timeStep)
 
     ImVec2 settingsWindowSize;
     settingsWindowSize.x = 400;
-    settingsWindowSize.y = 430;
+    settingsWindowSize.y = 627;
 
     ImGui::SetNextWindowPos(settingsWindowPosition);
     ImGui::SetNextWindowSizeConstraints(settingsWindowSize, settingsWindowSize);
@@ -75,6 +81,10 @@ void Application::Update(float timeStep)
     ImGui::Checkbox("Render Hair", &hairSettings.renderHair);
     ImGui::SliderFloat("Density", &hairSettings.density, 3.0f, 64.0f);
     ImGui::SliderFloat("Tesselation Factor", &hairSettings.tesselationFactor, 1.0f, 4.0f);
+    ImGui::Checkbox("Distance LOD", &hairSettings.lodEnabled);
+    ImGui::SliderFloat("LOD Min Density", &hairSettings.lodMinDensity, 1.0f, 64.0f);
+    ImGui::SliderFloat("LOD Min Tesselation Factor", &hairSettings.lodMinTesselationFactor, 1.0f, 4.0f);
+    ImGui::SliderFloat("LOD Full Detail Size", &hairSettings.lodFullDetailSize, 1.0f, 256.0f);
     ImGui::SliderFloat("Tip Width", &hairSettings.tipWidth, 0.0001f, 0.001f);
     ImGui::SliderFloat("Root Width", &hairSettings.rootWidth, 0.001f, 0.005f);
     ImGui::SliderFloat("Thinning Start", &hairSettings.thinningStart, 0.0f, 1.0f);
@@ -87,13 +97,20 @@ void Application::Update(float timeStep)
 	ImGui::SliderFloat("Local Stiffness", &hairSettings.localStiffness, 0.0f, 1.0f);
     ImGui::SliderFloat("Damping", &hairSettings.damping, 0.0f, 0.5f);
 	ImGui::SliderFloat("Wind Magnitude", &windMagnitude, 0.0f, 100.0f);
+    ImGui::Combo("Simulation Backend", (int*)&hairSettings.simulationBackend, "GPU\0CPU\0");
+
+    auto& frameStats = hairSystem->GetFrameStats();
+    ImGui::Separator();
+    ImGui::Text("Simulation: %.3f ms CPU, %.3f ms GPU", frameStats.simulationCPUTime, frameStats.simulationGPUTime);
+    ImGui::Text("Render: %.3f ms CPU, Culling: %.3f ms GPU", frameStats.renderCPUTime, frameStats.cullingGPUTime);
+    ImGui::Text("Guides: %.3f ms, Growth Mesh: %.3f ms, Hair: %.3f ms GPU", frameStats.guidesGPUTime, frameStats.growthMeshGPUTime, frameStats.hairGPUTime);
     ImGui::End();
     ImGui::Render();
 
 	hairSettings.wind = HairGL::Vector3(1.0f, 0.0f, 0.0f).Normalized() * windMagnitude;
 
     hairSystem->UpdateInstanceSettings(hairInstance, hairSettings);
-    hairSystem->Simulate(hairInstance, timeStep);
+    hairSystem->Advance(hairInstance, frameTime);
 }
 
 void Application::Render()
@@ -107,6 +124,7 @@ void Application::Render()
     glClearColor(0.9f, 0.9f, 0.9f, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     hairSystem->Render(hairInstance, viewMatrix, projectionMatrix);
+    hairSystem->EndFrame();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
     glfwSwapBuffers(window);
@@ -22,7 +22,7 @@ private:
 	float windMagnitude;
 
     void Render();
-    void Update(float timeStep);
+    void Update(float frameTime);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "AssetCache.h"
+#include <stdlib.h>
+
+namespace HairGL
+{
+    std::string AssetCache::GetKey(const char* path)
+    {
+        //Paths that can't be resolved are used as given, loading them fails anyway
+#ifdef _WIN32
+        char fullPath[_MAX_PATH];
+        if (_fullpath(fullPath, path, _MAX_PATH)) {
+            return fullPath;
+        }
+#else
+        char* fullPath = realpath(path, nullptr);
+        if (fullPath) {
+            std::string key(fullPath);
+            free(fullPath);
+            return key;
+        }
+#endif
+        return path;
+    }
+
+    HairAsset* AssetCache::Acquire(const std::string& key)
+    {
+        auto it = assets.find(key);
+        if (it == assets.end()) {
+            return nullptr;
+        }
+
+        it->second->referencesCount++;
+        return it->second;
+    }
+
+    HairAsset* AssetCache::Add(const std::string& key, HairAsset* asset)
+    {
+        //A file loaded twice before either load finished keeps the first copy
+        auto cached = Acquire(key);
+        if (cached) {
+            return cached;
+        }
+
+        asset->cacheKey = key;
+        asset->referencesCount = 1;
+        assets[key] = asset;
+        return asset;
+    }
+
+    void AssetCache::AddReference(const HairAsset* asset) const
+    {
+        asset->referencesCount++;
+    }
+
+    bool AssetCache::Release(const HairAsset* asset)
+    {
+        if (--asset->referencesCount > 0) {
+            return false;
+        }
+
+        assets.erase(asset->cacheKey);
+        return true;
+    }
+}
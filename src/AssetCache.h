@@ -0,0 +1,29 @@
+#ifndef HAIRGL_ASSET_CACHE_H
+#define HAIRGL_ASSET_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include "Common.h"
+
+namespace HairGL
+{
+    //Assets by canonical file path, so every load of a file shares one set of GPU buffers. Loads and
+    //instances each hold a reference, the asset is removed once the last one is released.
+    class AssetCache
+    {
+    public:
+        AssetCache() = default;
+        AssetCache(const AssetCache&) = delete;
+        static std::string GetKey(const char* path);
+        HairAsset* Acquire(const std::string& key);
+        HairAsset* Add(const std::string& key, HairAsset* asset);
+        void AddReference(const HairAsset* asset) const;
+        bool Release(const HairAsset* asset);
+
+    private:
+        std::unordered_map<std::string, HairAsset*> assets;
+    };
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include "AssetLoader.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+namespace HairGL
+{
+    //The loader thread and one helper
+    constexpr uint32_t LoaderThreadsCount = 2;
+
+    AssetLoader::AssetLoader(uint32_t maxStrandVertices, size_t uploadBudget, bool compactStorage) :
+        loaderPool((std::min)(std::thread::hardware_concurrency(), LoaderThreadsCount)),
+        maxStrandVertices(maxStrandVertices),
+        uploadBudget((std::max)(uploadBudget, (size_t)1)),
+        compactStorage(compactStorage),
+        stagingBuffer(nullptr),
+        stopping(false)
+    {
+        stagingBuffer = new RingBuffer(GL_COPY_READ_BUFFER, this->uploadBudget * 3);
+        worker = std::thread(&AssetLoader::WorkerLoop, this);
+    }
+
+    HairAssetLoad* AssetLoader::Load(const char* path, const std::string& cacheKey)
+    {
+        auto load = new HairAssetLoad();
+        load->path = path;
+        load->cacheKey = cacheKey;
+        load->state = HairAssetLoadState::Loading;
+        load->asset = nullptr;
+        load->uploadedSize = 0;
+        load->source = nullptr;
+        load->cached = false;
+
+        //A file already being loaded is read, precomputed and uploaded once, later loads wait for it
+        auto source = std::find_if(loads.begin(), loads.end(), [&cacheKey](const HairAssetLoad* other) {
+            return !other->source && !other->cached && other->cacheKey == cacheKey && other->state != HairAssetLoadState::Failed;
+        });
+        if (source != loads.end()) {
+            load->source = *source;
+            loads.push_back(load);
+            return load;
+        }
+        loads.push_back(load);
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(load);
+        queueCondition.notify_one();
+
+        return load;
+    }
+
+    HairAssetLoad* AssetLoader::AddLoaded(HairAsset* asset)
+    {
+        auto load = new HairAssetLoad();
+        load->path = asset->cacheKey;
+        load->state = HairAssetLoadState::Ready;
+        load->asset = asset;
+        load->uploadedSize = 0;
+        load->source = nullptr;
+        load->cached = true;
+        loads.push_back(load);
+        return load;
+    }
+
+    void AssetLoader::WorkerLoop()
+    {
+        while (true) {
+            HairAssetLoad* load;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping) {
+                    return;
+                }
+                load = queue.front();
+                queue.pop_front();
+            }
+
+            HairAssetLoadState state = HairAssetLoadState::Uploading;
+            try {
+                ReadAsset(load);
+            }
+            catch (const std::exception& e) {
+                load->error = e.what();
+                state = HairAssetLoadState::Failed;
+            }
+
+            std::lock_guard<std::mutex> lock(queueMutex);
+            load->state = state;
+            loadedCondition.notify_all();
+        }
+    }
+
+    void AssetLoader::ReadAsset(HairAssetLoad* load)
+    {
+        MappedFile file(load->path.c_str());
+        HairAssetFileView view;
+        ParseHairAssetFile(file.GetData(), file.GetSize(), load->path.c_str(), view);
+
+        int verticesPerStrand = view.segmentsCount + 1;
+
+        if ((uint32_t)verticesPerStrand > maxStrandVertices) {
+            throw std::runtime_error(std::string("Strands exceed maxStrandVertices in hair asset file ") + load->path);
+        }
+
+        ReadHairAssetData(view, load->data, &loaderPool);
+
+        if (compactStorage) {
+            PackHairAssetData(load->data, load->compactData);
+        }
+    }
+
+    uint32_t CreateEmptyBuffer(size_t size)
+    {
+        uint32_t bufferID;
+        glGenBuffers(1, &bufferID);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return bufferID;
+    }
+
+    template <typename T>
+    size_t GetDataSize(const std::vector<T>& elements)
+    {
+        return elements.size() * sizeof(T);
+    }
+
+    void AssetLoader::CreateAsset(HairAssetLoad* load) const
+    {
+        auto& data = load->data;
+
+        auto asset = new HairAsset();
+        asset->guidesCount = data.guidesCount;
+        asset->segmentsCount = data.segmentsCount;
+        asset->trianglesCount = data.trianglesCount;
+        asset->cpuData = nullptr;
+        asset->instancePool = {};
+        asset->compact = compactStorage;
+        asset->restBoundsMin = load->compactData.boundsMin;
+        asset->restBoundsSize = load->compactData.boundsSize;
+        asset->reachBoundsMin = data.reachBoundsMin;
+        asset->reachBoundsMax = data.reachBoundsMax;
+
+        //Buffers are allocated when their section starts uploading, allocation is not free either
+        asset->restPositionsBufferID = 0;
+        asset->hairIndicesBufferID = 0;
+        asset->tangentsDistancesBufferID = 0;
+        asset->refVectorsBufferID = 0;
+        asset->globalRotationsBufferID = 0;
+        asset->debugBufferID = 0;
+
+        load->asset = asset;
+    }
+
+    size_t AssetLoader::UploadAsset(HairAssetLoad* load, size_t budget) const
+    {
+        auto& data = load->data;
+        auto& compactData = load->compactData;
+        auto asset = load->asset;
+        UploadSection sections[] = {
+            { &asset->restPositionsBufferID, data.positions.data(), GetDataSize(data.positions) },
+            { &asset->hairIndicesBufferID, data.triangles.data(), GetDataSize(data.triangles) },
+            { &asset->tangentsDistancesBufferID, data.tangentsDistances.data(), GetDataSize(data.tangentsDistances) },
+            { &asset->refVectorsBufferID, data.refVectors.data(), GetDataSize(data.refVectors) },
+            { &asset->globalRotationsBufferID, data.globalRotations.data(), GetDataSize(data.globalRotations) }
+        };
+
+        if (asset->compact) {
+            sections[0] = { &asset->restPositionsBufferID, compactData.restPositions.data(), GetDataSize(compactData.restPositions) };
+            sections[2] = { &asset->tangentsDistancesBufferID, compactData.tangentsDistances.data(), GetDataSize(compactData.tangentsDistances) };
+            sections[3] = { &asset->refVectorsBufferID, compactData.refVectors.data(), GetDataSize(compactData.refVectors) };
+            sections[4] = { &asset->globalRotationsBufferID, compactData.globalRotations.data(), GetDataSize(compactData.globalRotations) };
+        }
+
+        //Sections are uploaded back to back, uploadedSize is the offset into all of them
+        size_t uploadedSize = 0;
+        size_t sectionStart = 0;
+        for (auto& section : sections) {
+            size_t sectionEnd = sectionStart + section.size;
+            if (*section.bufferID == 0 && load->uploadedSize >= sectionStart) {
+                *section.bufferID = CreateEmptyBuffer(section.size);
+            }
+
+            while (load->uploadedSize < sectionEnd && uploadedSize < budget) {
+                size_t offset = load->uploadedSize - sectionStart;
+                size_t size = (std::min)(sectionEnd - load->uploadedSize, budget - uploadedSize);
+
+                size_t stagingOffset = stagingBuffer->Write(static_cast<const uint8_t*>(section.data) + offset, size);
+                glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer->GetBufferID());
+                glBindBuffer(GL_COPY_WRITE_BUFFER, *section.bufferID);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stagingOffset, offset, size);
+
+                load->uploadedSize += size;
+                uploadedSize += size;
+            }
+            sectionStart = sectionEnd;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        if (load->uploadedSize == sectionStart) {
+            asset->debugBufferID = CreateEmptyBuffer(GetDataSize(data.positions));
+            if (asset->compact) {
+                asset->cpuData = CreateCompactCPUData(data);
+            }
+            data = HairAssetData();
+            compactData = HairAssetCompactData();
+            load->state = HairAssetLoadState::Ready;
+        }
+
+        return uploadedSize;
+    }
+
+    void AssetLoader::Upload()
+    {
+        //Loads are uploaded in the order they were requested, so the oldest one becomes ready first
+        size_t budget = uploadBudget;
+        stagingBuffer->Reserve(budget);
+
+        for (auto load : loads) {
+            if (budget == 0) {
+                break;
+            }
+            if (load->state != HairAssetLoadState::Uploading) {
+                continue;
+            }
+            if (!load->asset) {
+                CreateAsset(load);
+            }
+            budget -= UploadAsset(load, budget);
+        }
+
+        stagingBuffer->Fence();
+    }
+
+    void AssetLoader::Complete(HairAssetLoad* load)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            loadedCondition.wait(lock, [load]() { return load->state != HairAssetLoadState::Loading; });
+        }
+
+        //The rest is uploaded now, still in budget sized steps so the staging ring does not grow
+        if (load->state == HairAssetLoadState::Uploading) {
+            if (!load->asset) {
+                CreateAsset(load);
+            }
+            while (load->state == HairAssetLoadState::Uploading) {
+                stagingBuffer->Reserve(uploadBudget);
+                UploadAsset(load, uploadBudget);
+                stagingBuffer->Fence();
+            }
+        }
+    }
+
+    std::vector<HairAssetLoad*> AssetLoader::DetachWaitingLoads(const HairAssetLoad* source)
+    {
+        std::vector<HairAssetLoad*> waitingLoads;
+        for (auto load : loads) {
+            if (load->source == source) {
+                load->source = nullptr;
+                waitingLoads.push_back(load);
+            }
+        }
+        return waitingLoads;
+    }
+
+    HairAsset* AssetLoader::Finish(HairAssetLoad* load)
+    {
+        Complete(load);
+        loads.erase(std::find(loads.begin(), loads.end(), load));
+
+        if (load->state == HairAssetLoadState::Failed) {
+            std::string error = load->error;
+            delete load;
+            throw std::runtime_error(error);
+        }
+
+        auto asset = load->asset;
+        delete load;
+        return asset;
+    }
+
+    void AssetLoader::DestroyLoad(HairAssetLoad* load) const
+    {
+        //Assets already in the cache belong to it
+        if (load->asset && load->asset->cacheKey.empty()) {
+            glDeleteBuffers(1, &load->asset->restPositionsBufferID);
+            glDeleteBuffers(1, &load->asset->hairIndicesBufferID);
+            glDeleteBuffers(1, &load->asset->tangentsDistancesBufferID);
+            glDeleteBuffers(1, &load->asset->refVectorsBufferID);
+            glDeleteBuffers(1, &load->asset->globalRotationsBufferID);
+            glDeleteBuffers(1, &load->asset->debugBufferID);
+            delete load->asset;
+        }
+        delete load;
+    }
+
+    AssetLoader::~AssetLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+            queueCondition.notify_all();
+        }
+        worker.join();
+
+        //Loads that were never finished own their partially uploaded assets
+        for (auto load : loads) {
+            DestroyLoad(load);
+        }
+
+        delete stagingBuffer;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef HAIRGL_ASSET_LOADER_H
+#define HAIRGL_ASSET_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hairgl/HairTypes.h>
+#include "Common.h"
+#include "HairAssetFile.h"
+#include "CompactStorage.h"
+#include "gl/RingBuffer.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace HairGL
+{
+    class HairAssetLoad
+    {
+    public:
+        std::string path;
+        std::string cacheKey;
+        std::atomic<HairAssetLoadState> state;
+        std::string error;
+        HairAssetData data;
+        HairAssetCompactData compactData;
+        HairAsset* asset;
+        size_t uploadedSize;
+        //Load of the same file this one waits for instead of reading it again
+        HairAssetLoad* source;
+        //The asset is in the cache and this load holds a reference to it
+        bool cached;
+    };
+
+    //Reads and prepares assets on a worker thread, then copies them to the GPU through a staging
+    //ring a limited number of bytes per frame. Only Load, Upload and Finish touch GL and must be
+    //called on the GL thread. Precomputation runs on a small pool of its own, so loads do not
+    //queue up behind or delay the work of the CPU backend on the shared pool.
+    class AssetLoader
+    {
+    public:
+        AssetLoader(uint32_t maxStrandVertices, size_t uploadBudget, bool compactStorage);
+        AssetLoader(const AssetLoader&) = delete;
+        HairAssetLoad* Load(const char* path, const std::string& cacheKey);
+        HairAssetLoad* AddLoaded(HairAsset* asset);
+        void Upload();
+        //Waits for the worker and uploads the rest, the load is then Ready or Failed
+        void Complete(HairAssetLoad* load);
+        //Loads waiting for source, which no longer do
+        std::vector<HairAssetLoad*> DetachWaitingLoads(const HairAssetLoad* source);
+        HairAsset* Finish(HairAssetLoad* load);
+        ~AssetLoader();
+
+    private:
+        struct UploadSection
+        {
+            uint32_t* bufferID;
+            const void* data;
+            size_t size;
+        };
+
+        ThreadPool loaderPool;
+        uint32_t maxStrandVertices;
+        size_t uploadBudget;
+        bool compactStorage;
+        RingBuffer* stagingBuffer;
+        std::vector<HairAssetLoad*> loads;
+
+        std::thread worker;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::condition_variable loadedCondition;
+        std::deque<HairAssetLoad*> queue;
+        bool stopping;
+
+        void WorkerLoop();
+        void ReadAsset(HairAssetLoad* load);
+        void CreateAsset(HairAssetLoad* load) const;
+        size_t UploadAsset(HairAssetLoad* load, size_t budget) const;
+        void DestroyLoad(HairAssetLoad* load) const;
+    };
+}
+
+#endif
@@ -0,0 +1,640 @@
+#include "CPUSimulator.h"
+#include "gl/GLUtils.h"
+#include "shaders/ShaderTypes.h"
+#include <algorithm>
+#include <math.h>
+
+namespace HairGL
+{
+    //Strands are simulated in batches laid out as structure of arrays, so every
+    //step below is a loop over the lanes of one batch that the compiler can vectorize.
+    constexpr uint32_t StrandBatchSize = 8;
+
+    struct BatchVector
+    {
+        float x[StrandBatchSize];
+        float y[StrandBatchSize];
+        float z[StrandBatchSize];
+        float w[StrandBatchSize];
+    };
+
+    struct StrandBatch
+    {
+        std::vector<BatchVector> positions;
+        std::vector<BatchVector> currentPositions;
+        std::vector<BatchVector> previousPositions;
+        std::vector<BatchVector> restPositions;
+        std::vector<BatchVector> tangentsDistances;
+        std::vector<BatchVector> refVectors;
+        std::vector<BatchVector> localShapeDeltas;
+        BatchVector rootRotations;
+
+        explicit StrandBatch(uint32_t verticesPerStrand) :
+            positions(verticesPerStrand),
+            currentPositions(verticesPerStrand),
+            previousPositions(verticesPerStrand),
+            restPositions(verticesPerStrand),
+            tangentsDistances(verticesPerStrand),
+            refVectors(verticesPerStrand),
+            localShapeDeltas(verticesPerStrand)
+        {
+        }
+    };
+
+    inline void StoreLane(BatchVector& batchVector, uint32_t lane, const Vector4& v)
+    {
+        batchVector.x[lane] = v.x;
+        batchVector.y[lane] = v.y;
+        batchVector.z[lane] = v.z;
+        batchVector.w[lane] = v.w;
+    }
+
+    inline Vector4 LoadLane(const BatchVector& batchVector, uint32_t lane)
+    {
+        return Vector4(batchVector.x[lane], batchVector.y[lane], batchVector.z[lane], batchVector.w[lane]);
+    }
+
+    void GatherBatch(const HairAssetCPUData& assetData, const HairInstance* instance, uint32_t firstGuide, StrandBatch& batch)
+    {
+        uint32_t verticesPerStrand = instance->asset->segmentsCount + 1;
+        uint32_t lastGuide = instance->asset->guidesCount - 1;
+
+        for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+            //Lanes past the end of the asset replicate the last guide and are never written back
+            uint32_t rootVertexIndex = (std::min)(firstGuide + lane, lastGuide) * verticesPerStrand;
+
+            auto& rotation = assetData.globalRotations[rootVertexIndex];
+            StoreLane(batch.rootRotations, lane, Vector4(rotation.x, rotation.y, rotation.z, rotation.w));
+
+            for (uint32_t i = 0; i < verticesPerStrand; i++) {
+                uint32_t vertexIndex = rootVertexIndex + i;
+                StoreLane(batch.currentPositions[i], lane, instance->cpuPositions[vertexIndex]);
+                StoreLane(batch.previousPositions[i], lane, instance->cpuPreviousPositions[vertexIndex]);
+                StoreLane(batch.restPositions[i], lane, assetData.restPositions[vertexIndex]);
+                StoreLane(batch.tangentsDistances[i], lane, assetData.tangentsDistances[vertexIndex]);
+                StoreLane(batch.refVectors[i], lane, assetData.refVectors[vertexIndex]);
+            }
+        }
+    }
+
+    void ScatterBatch(const StrandBatch& batch, uint32_t firstGuide, HairInstance* instance)
+    {
+        uint32_t verticesPerStrand = instance->asset->segmentsCount + 1;
+        uint32_t lanesCount = (std::min)(StrandBatchSize, instance->asset->guidesCount - firstGuide);
+
+        for (uint32_t lane = 0; lane < lanesCount; lane++) {
+            uint32_t rootVertexIndex = (firstGuide + lane) * verticesPerStrand;
+            for (uint32_t i = 0; i < verticesPerStrand; i++) {
+                instance->cpuPositions[rootVertexIndex + i] = LoadLane(batch.positions[i], lane);
+                instance->cpuPreviousPositions[rootVertexIndex + i] = LoadLane(batch.currentPositions[i], lane);
+            }
+        }
+    }
+
+    void Integrate(const SimulationParameters& parameters, uint32_t firstGuide, uint32_t verticesPerStrand, StrandBatch& batch)
+    {
+        auto& windPyramid = parameters.windPyramid.m;
+        bool hasWind = windPyramid[0].XYZ().Length() != 0;
+        float timeStep2 = parameters.timeStep * parameters.timeStep;
+
+        for (uint32_t i = 0; i < verticesPerStrand; i++) {
+            auto& current = batch.currentPositions[i];
+            auto& previous = batch.previousPositions[i];
+            auto& rest = batch.restPositions[i];
+            auto& position = batch.positions[i];
+            bool applyWind = hasWind && i >= 2 && i < verticesPerStrand - 1;
+
+            for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                float forceX = parameters.gravity.x;
+                float forceY = parameters.gravity.y;
+                float forceZ = parameters.gravity.z;
+
+                if (applyWind) {
+                    auto& next = batch.currentPositions[i + 1];
+                    float a = ((firstGuide + lane) % 20) / 20.0f;
+                    float windX = a * (windPyramid[0].x + windPyramid[2].x) + (1.0f - a) * (windPyramid[1].x + windPyramid[3].x);
+                    float windY = a * (windPyramid[0].y + windPyramid[2].y) + (1.0f - a) * (windPyramid[1].y + windPyramid[3].y);
+                    float windZ = a * (windPyramid[0].z + windPyramid[2].z) + (1.0f - a) * (windPyramid[1].z + windPyramid[3].z);
+
+                    float tangentX = current.x[lane] - next.x[lane];
+                    float tangentY = current.y[lane] - next.y[lane];
+                    float tangentZ = current.z[lane] - next.z[lane];
+                    float tangentLength = sqrtf(tangentX * tangentX + tangentY * tangentY + tangentZ * tangentZ);
+                    tangentX /= tangentLength;
+                    tangentY /= tangentLength;
+                    tangentZ /= tangentLength;
+
+                    float crossX = tangentY * windZ - tangentZ * windY;
+                    float crossY = tangentZ * windX - tangentX * windZ;
+                    float crossZ = tangentX * windY - tangentY * windX;
+
+                    forceX += crossY * tangentZ - crossZ * tangentY;
+                    forceY += crossZ * tangentX - crossX * tangentZ;
+                    forceZ += crossX * tangentY - crossY * tangentX;
+                }
+
+                bool isMovable = current.w[lane] > 0;
+                float velocityCoeff = isMovable ? 1.0f - parameters.damping : 0.0f;
+                float forceCoeff = isMovable ? timeStep2 : 0.0f;
+
+                position.x[lane] = current.x[lane] + velocityCoeff * (current.x[lane] - previous.x[lane]) + forceCoeff * forceX;
+                position.y[lane] = current.y[lane] + velocityCoeff * (current.y[lane] - previous.y[lane]) + forceCoeff * forceY;
+                position.z[lane] = current.z[lane] + velocityCoeff * (current.z[lane] - previous.z[lane]) + forceCoeff * forceZ;
+                position.w[lane] = current.w[lane];
+
+                position.x[lane] += parameters.globalStiffness * (rest.x[lane] - position.x[lane]);
+                position.y[lane] += parameters.globalStiffness * (rest.y[lane] - position.y[lane]);
+                position.z[lane] += parameters.globalStiffness * (rest.z[lane] - position.z[lane]);
+            }
+        }
+    }
+
+    void ApplyLocalShapeConstraints(const SimulationParameters& parameters, uint32_t verticesPerStrand, StrandBatch& batch)
+    {
+        //Same Jacobi formulation as the compute shader: every segment solves its constraint against the
+        //positions at the start of the iteration, in a frame transported from the root along the tangents
+        float stiffness = parameters.localStiffness;
+        auto& rootRotations = batch.rootRotations;
+        auto& deltas = batch.localShapeDeltas;
+
+        for (int iteration = 0; iteration < parameters.localShapeIterations; iteration++) {
+            BatchVector rotation = rootRotations;
+            BatchVector previousTangent;
+
+            for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                //Root rotation applied to the X axis
+                float qx = rootRotations.x[lane];
+                float qy = rootRotations.y[lane];
+                float qz = rootRotations.z[lane];
+                float qw = rootRotations.w[lane];
+                previousTangent.x[lane] = 1.0f - 2.0f * (qy * qy + qz * qz);
+                previousTangent.y[lane] = 2.0f * (qx * qy + qw * qz);
+                previousTangent.z[lane] = 2.0f * (qx * qz - qw * qy);
+            }
+
+            for (uint32_t i = 1; i + 1 < verticesPerStrand; i++) {
+                auto& position = batch.positions[i];
+                auto& positionNext = batch.positions[i + 1];
+                auto& refVector = batch.refVectors[i + 1];
+                auto& delta = deltas[i];
+
+                for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                    float qx = rotation.x[lane];
+                    float qy = rotation.y[lane];
+                    float qz = rotation.z[lane];
+                    float qw = rotation.w[lane];
+
+                    //Target position of the next vertex: rotation * refVector + position
+                    float rx = refVector.x[lane];
+                    float ry = refVector.y[lane];
+                    float rz = refVector.z[lane];
+                    float uvX = qy * rz - qz * ry;
+                    float uvY = qz * rx - qx * rz;
+                    float uvZ = qx * ry - qy * rx;
+                    float uuvX = qy * uvZ - qz * uvY;
+                    float uuvY = qz * uvX - qx * uvZ;
+                    float uuvZ = qx * uvY - qy * uvX;
+                    float targetX = rx + 2.0f * (qw * uvX + uuvX) + position.x[lane];
+                    float targetY = ry + 2.0f * (qw * uvY + uuvY) + position.y[lane];
+                    float targetZ = rz + 2.0f * (qw * uvZ + uuvZ) + position.z[lane];
+
+                    delta.x[lane] = stiffness * (targetX - positionNext.x[lane]);
+                    delta.y[lane] = stiffness * (targetY - positionNext.y[lane]);
+                    delta.z[lane] = stiffness * (targetZ - positionNext.z[lane]);
+
+                    float tangentX = positionNext.x[lane] - position.x[lane];
+                    float tangentY = positionNext.y[lane] - position.y[lane];
+                    float tangentZ = positionNext.z[lane] - position.z[lane];
+                    float tangentLength = sqrtf(tangentX * tangentX + tangentY * tangentY + tangentZ * tangentZ);
+                    tangentX /= tangentLength;
+                    tangentY /= tangentLength;
+                    tangentZ /= tangentLength;
+
+                    //Shortest rotation from the previous tangent to this one, applied on top of the frame
+                    float ax = previousTangent.x[lane];
+                    float ay = previousTangent.y[lane];
+                    float az = previousTangent.z[lane];
+                    float bx = ay * tangentZ - az * tangentY;
+                    float by = az * tangentX - ax * tangentZ;
+                    float bz = ax * tangentY - ay * tangentX;
+                    float bw = 1.0f + ax * tangentX + ay * tangentY + az * tangentZ;
+
+                    if (bw >= 1e-6f) {
+                        float bLength = sqrtf(bx * bx + by * by + bz * bz + bw * bw);
+                        bx /= bLength;
+                        by /= bLength;
+                        bz /= bLength;
+                        bw /= bLength;
+
+                        rotation.w[lane] = bw * qw - bx * qx - by * qy - bz * qz;
+                        rotation.x[lane] = bw * qx + bx * qw + by * qz - bz * qy;
+                        rotation.y[lane] = bw * qy + by * qw + bz * qx - bx * qz;
+                        rotation.z[lane] = bw * qz + bz * qw + bx * qy - by * qx;
+                    }
+
+                    previousTangent.x[lane] = tangentX;
+                    previousTangent.y[lane] = tangentY;
+                    previousTangent.z[lane] = tangentZ;
+                }
+            }
+
+            //A vertex between two segments receives the average of both corrections
+            for (uint32_t i = 1; i < verticesPerStrand; i++) {
+                auto& position = batch.positions[i];
+                bool hasPrevious = i >= 2;
+                bool hasNext = i + 1 < verticesPerStrand;
+                float weight = hasPrevious && hasNext ? 0.5f : 1.0f;
+
+                for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                    float coeff = position.w[lane] > 0 ? weight : 0.0f;
+                    float correctionX = (hasPrevious ? deltas[i - 1].x[lane] : 0.0f) - (hasNext ? deltas[i].x[lane] : 0.0f);
+                    float correctionY = (hasPrevious ? deltas[i - 1].y[lane] : 0.0f) - (hasNext ? deltas[i].y[lane] : 0.0f);
+                    float correctionZ = (hasPrevious ? deltas[i - 1].z[lane] : 0.0f) - (hasNext ? deltas[i].z[lane] : 0.0f);
+
+                    position.x[lane] += coeff * correctionX;
+                    position.y[lane] += coeff * correctionY;
+                    position.z[lane] += coeff * correctionZ;
+                }
+            }
+        }
+    }
+
+    void ApplyDistanceConstraint(BatchVector& p0, BatchVector& p1, const BatchVector& tangentDistance)
+    {
+        for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+            float deltaX = p1.x[lane] - p0.x[lane];
+            float deltaY = p1.y[lane] - p0.y[lane];
+            float deltaZ = p1.z[lane] - p0.z[lane];
+            float distance = (std::max)(sqrtf(deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ), 1e-7f);
+            float stretching = 1.0f - tangentDistance.w[lane] / distance;
+
+            bool isMovable0 = p0.w[lane] > 0;
+            bool isMovable1 = p1.w[lane] > 0;
+            float multiplier0 = isMovable0 ? (isMovable1 ? 0.5f : 1.0f) : 0.0f;
+            float multiplier1 = isMovable1 ? (isMovable0 ? 0.5f : 1.0f) : 0.0f;
+
+            p0.x[lane] += multiplier0 * stretching * deltaX;
+            p0.y[lane] += multiplier0 * stretching * deltaY;
+            p0.z[lane] += multiplier0 * stretching * deltaZ;
+            p1.x[lane] -= multiplier1 * stretching * deltaX;
+            p1.y[lane] -= multiplier1 * stretching * deltaY;
+            p1.z[lane] -= multiplier1 * stretching * deltaZ;
+        }
+    }
+
+    void ApplyLengthConstraints(const SimulationParameters& parameters, uint32_t verticesPerStrand, StrandBatch& batch)
+    {
+        //Even and odd segments are independent of each other, as in the red/black passes of the compute shader
+        for (int iteration = 0; iteration < parameters.lengthConstraintIterations; iteration++) {
+            for (uint32_t i = 0; i + 1 < verticesPerStrand; i += 2) {
+                ApplyDistanceConstraint(batch.positions[i], batch.positions[i + 1], batch.tangentsDistances[i]);
+            }
+
+            for (uint32_t i = 1; i + 1 < verticesPerStrand; i += 2) {
+                ApplyDistanceConstraint(batch.positions[i], batch.positions[i + 1], batch.tangentsDistances[i]);
+            }
+        }
+    }
+
+    void ApplyCollisions(const std::vector<HairCollider>& colliders, uint32_t verticesPerStrand, StrandBatch& batch)
+    {
+        if (colliders.empty()) {
+            return;
+        }
+
+        //Bounds of every strand, taken before any collider moves it, as in the compute shader
+        BatchVector boundsMin = batch.positions[0];
+        BatchVector boundsMax = batch.positions[0];
+        for (uint32_t i = 1; i < verticesPerStrand; i++) {
+            auto& position = batch.positions[i];
+            for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                boundsMin.x[lane] = (std::min)(boundsMin.x[lane], position.x[lane]);
+                boundsMin.y[lane] = (std::min)(boundsMin.y[lane], position.y[lane]);
+                boundsMin.z[lane] = (std::min)(boundsMin.z[lane], position.z[lane]);
+                boundsMax.x[lane] = (std::max)(boundsMax.x[lane], position.x[lane]);
+                boundsMax.y[lane] = (std::max)(boundsMax.y[lane], position.y[lane]);
+                boundsMax.z[lane] = (std::max)(boundsMax.z[lane], position.z[lane]);
+            }
+        }
+
+        //Colliders are applied in order, each one pushing the movable vertices inside it to its surface
+        for (auto& collider : colliders) {
+            Vector3 colliderMin;
+            Vector3 colliderMax;
+            for (int k = 0; k < 3; k++) {
+                colliderMin.m[k] = (std::min)(collider.start.m[k], collider.end.m[k]) - collider.radius;
+                colliderMax.m[k] = (std::max)(collider.start.m[k], collider.end.m[k]) + collider.radius;
+            }
+
+            bool hits[StrandBatchSize];
+            bool anyHit = false;
+            for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                hits[lane] = colliderMin.x <= boundsMax.x[lane] && colliderMin.y <= boundsMax.y[lane] && colliderMin.z <= boundsMax.z[lane] &&
+                    boundsMin.x[lane] <= colliderMax.x && boundsMin.y[lane] <= colliderMax.y && boundsMin.z[lane] <= colliderMax.z;
+                anyHit = anyHit || hits[lane];
+            }
+            if (!anyHit) {
+                continue;
+            }
+
+            auto axis = collider.end - collider.start;
+            float axisLengthSqr = (std::max)(Vector3::Dot(axis, axis), 1e-12f);
+
+            for (uint32_t i = 0; i < verticesPerStrand; i++) {
+                auto& position = batch.positions[i];
+
+                for (uint32_t lane = 0; lane < StrandBatchSize; lane++) {
+                    float toStartX = position.x[lane] - collider.start.x;
+                    float toStartY = position.y[lane] - collider.start.y;
+                    float toStartZ = position.z[lane] - collider.start.z;
+                    float t = (toStartX * axis.x + toStartY * axis.y + toStartZ * axis.z) / axisLengthSqr;
+                    t = (std::min)((std::max)(t, 0.0f), 1.0f);
+
+                    float offsetX = toStartX - t * axis.x;
+                    float offsetY = toStartY - t * axis.y;
+                    float offsetZ = toStartZ - t * axis.z;
+                    float distance = sqrtf(offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ);
+                    bool inside = hits[lane] && position.w[lane] > 0 && distance < collider.radius && distance > 1e-7f;
+                    float scale = inside ? collider.radius / distance - 1.0f : 0.0f;
+
+                    position.x[lane] += offsetX * scale;
+                    position.y[lane] += offsetY * scale;
+                    position.z[lane] += offsetZ * scale;
+                }
+            }
+        }
+    }
+
+    //Position of a vertex relative to the cell centers of the interaction grid
+    struct GridSample
+    {
+        int baseCell[3];
+        float fraction[3];
+    };
+
+    GridSample GetGridSample(const InteractionGrid& grid, const Vector4& position)
+    {
+        GridSample sample;
+        for (int k = 0; k < 3; k++) {
+            float gridPosition = (position.m[k] - grid.origin.m[k]) / grid.cellSize.m[k] - 0.5f;
+            sample.baseCell[k] = (int)floorf(gridPosition);
+            sample.fraction[k] = gridPosition - sample.baseCell[k];
+        }
+        return sample;
+    }
+
+    bool IsInGrid(const InteractionGrid& grid, const int* cell)
+    {
+        int resolution = grid.resolution;
+        return cell[0] >= 0 && cell[0] < resolution && cell[1] >= 0 && cell[1] < resolution && cell[2] >= 0 && cell[2] < resolution;
+    }
+
+    size_t GetCellIndex(const InteractionGrid& grid, const int* cell)
+    {
+        size_t resolution = grid.resolution;
+        return ((cell[2] * resolution + cell[1]) * resolution + cell[0]) * 4;
+    }
+
+    float GetCellDensity(const std::vector<int32_t>& cells, const InteractionGrid& grid, const int* cell)
+    {
+        return IsInGrid(grid, cell) ? cells[GetCellIndex(grid, cell)] / (float)INTERACTION_DENSITY_SCALE : 0.0f;
+    }
+
+    //Weight the sample splatted into the cell at offset from its base cell, nonzero for the eight cells around it
+    float GetSampleWeight(const GridSample& sample, const int* offset)
+    {
+        float weight = 1.0f;
+        for (int k = 0; k < 3; k++) {
+            if (offset[k] < 0 || offset[k] > 1) {
+                return 0.0f;
+            }
+            weight *= offset[k] ? sample.fraction[k] : 1.0f - sample.fraction[k];
+        }
+        return weight;
+    }
+
+    int32_t ToFixedPoint(float value, float scale)
+    {
+        return (int32_t)floorf(value * scale + 0.5f);
+    }
+
+    //Exactly what the sample splatted into the cell at offset from its base cell, in the fixed point of the grid
+    float GetOwnCellDensity(const InteractionGrid& grid, const GridSample& sample, const int* offset)
+    {
+        int cell[3] = { sample.baseCell[0] + offset[0], sample.baseCell[1] + offset[1], sample.baseCell[2] + offset[2] };
+        if (!IsInGrid(grid, cell)) {
+            return 0.0f;
+        }
+        return ToFixedPoint(GetSampleWeight(sample, offset), INTERACTION_DENSITY_SCALE) / (float)INTERACTION_DENSITY_SCALE;
+    }
+
+    CPUSimulator::CPUSimulator(ThreadPool& threadPool, uint32_t interactionGridResolution) :
+        threadPool(threadPool),
+        interactionGridResolution(interactionGridResolution)
+    {
+    }
+
+    void CPUSimulator::Simulate(HairInstance* instance, float timeStep) const
+    {
+        auto asset = instance->asset;
+        if (asset->guidesCount == 0) {
+            return;
+        }
+
+        PrepareAssetData(asset);
+        PreparePositions(instance);
+
+        auto parameters = CreateSimulationParameters(instance, timeStep);
+        uint32_t verticesPerStrand = asset->segmentsCount + 1;
+        uint32_t batchesCount = (asset->guidesCount + StrandBatchSize - 1) / StrandBatchSize;
+        uint32_t grainSize = (std::max)(1u, batchesCount / (threadPool.GetThreadsCount() * 4));
+
+        threadPool.ParallelFor(batchesCount, grainSize, [&](uint32_t begin, uint32_t end) {
+            StrandBatch batch(verticesPerStrand);
+
+            for (uint32_t batchIndex = begin; batchIndex < end; batchIndex++) {
+                uint32_t firstGuide = batchIndex * StrandBatchSize;
+                GatherBatch(*asset->cpuData, instance, firstGuide, batch);
+                Integrate(parameters, firstGuide, verticesPerStrand, batch);
+                ApplyLocalShapeConstraints(parameters, verticesPerStrand, batch);
+                ApplyLengthConstraints(parameters, verticesPerStrand, batch);
+                ApplyCollisions(instance->colliders, verticesPerStrand, batch);
+                ScatterBatch(batch, firstGuide, instance);
+            }
+        });
+
+        if (HasHairInteraction(instance->settings)) {
+            ApplyHairInteraction(instance);
+        }
+
+        UploadPositions(instance);
+        instance->simulationFrame++;
+    }
+
+    void CPUSimulator::ApplyHairInteraction(HairInstance* instance) const
+    {
+        auto grid = GetInteractionGrid(instance->asset, interactionGridResolution);
+        auto& positions = instance->cpuPositions;
+        auto& previousPositions = instance->cpuPreviousPositions;
+        float densityScale = INTERACTION_DENSITY_SCALE;
+        float velocityScale = INTERACTION_VELOCITY_SCALE;
+
+        //Fixed point sums, so the serial splat matches the atomics of the GPU
+        interactionCells.assign((size_t)grid.resolution * grid.resolution * grid.resolution * 4, 0);
+        auto& cells = interactionCells;
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto velocity = positions[i].XYZ() - previousPositions[i].XYZ();
+            auto sample = GetGridSample(grid, positions[i]);
+            for (int corner = 0; corner < 8; corner++) {
+                int offset[3] = { corner & 1, (corner >> 1) & 1, corner >> 2 };
+                int cell[3] = { sample.baseCell[0] + offset[0], sample.baseCell[1] + offset[1], sample.baseCell[2] + offset[2] };
+                if (!IsInGrid(grid, cell)) {
+                    continue;
+                }
+
+                auto cellData = &cells[GetCellIndex(grid, cell)];
+                float weight = GetSampleWeight(sample, offset);
+                cellData[0] += ToFixedPoint(weight, densityScale);
+                cellData[1] += ToFixedPoint(weight * velocity.x, velocityScale);
+                cellData[2] += ToFixedPoint(weight * velocity.y, velocityScale);
+                cellData[3] += ToFixedPoint(weight * velocity.z, velocityScale);
+            }
+        }
+
+        auto& settings = instance->settings;
+        uint32_t verticesCount = positions.size();
+        uint32_t grainSize = (std::max)(1024u, verticesCount / (threadPool.GetThreadsCount() * 4));
+        threadPool.ParallelFor(verticesCount, grainSize, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                auto& position = positions[i];
+                if (position.w <= 0) {
+                    continue;
+                }
+
+                //Density, gradient and velocity sum at the vertex, without what it splatted itself
+                //rounded exactly as it was splatted
+                auto velocity = position.XYZ() - previousPositions[i].XYZ();
+                auto sample = GetGridSample(grid, position);
+                float density = 0.0f;
+                Vector3 gradient;
+                Vector3 velocitySum;
+                float ownDensity = 0.0f;
+                Vector3 ownGradient;
+                Vector3 ownVelocitySum;
+
+                for (int corner = 0; corner < 8; corner++) {
+                    int offset[3] = { corner & 1, (corner >> 1) & 1, corner >> 2 };
+                    int cell[3] = { sample.baseCell[0] + offset[0], sample.baseCell[1] + offset[1], sample.baseCell[2] + offset[2] };
+                    if (!IsInGrid(grid, cell)) {
+                        continue;
+                    }
+
+                    auto cellData = &cells[GetCellIndex(grid, cell)];
+                    float weight = GetSampleWeight(sample, offset);
+                    float cellDensity = cellData[0] / densityScale;
+                    Vector3 cellVelocity(cellData[1] / velocityScale, cellData[2] / velocityScale, cellData[3] / velocityScale);
+
+                    //Central differences between the neighbouring cells, for the grid and for the vertex alone
+                    Vector3 cellGradient;
+                    Vector3 ownCellGradient;
+                    for (int k = 0; k < 3; k++) {
+                        int next[3] = { cell[0], cell[1], cell[2] };
+                        int previous[3] = { cell[0], cell[1], cell[2] };
+                        next[k]++;
+                        previous[k]--;
+                        cellGradient.m[k] = 0.5f * (GetCellDensity(cells, grid, next) - GetCellDensity(cells, grid, previous));
+
+                        int nextOffset[3] = { offset[0], offset[1], offset[2] };
+                        int previousOffset[3] = { offset[0], offset[1], offset[2] };
+                        nextOffset[k]++;
+                        previousOffset[k]--;
+                        ownCellGradient.m[k] = 0.5f * (GetOwnCellDensity(grid, sample, nextOffset) - GetOwnCellDensity(grid, sample, previousOffset));
+                    }
+                    Vector3 ownCellVelocity(
+                        ToFixedPoint(weight * velocity.x, velocityScale) / velocityScale,
+                        ToFixedPoint(weight * velocity.y, velocityScale) / velocityScale,
+                        ToFixedPoint(weight * velocity.z, velocityScale) / velocityScale);
+
+                    density += weight * cellDensity;
+                    gradient += cellGradient * weight;
+                    velocitySum += cellVelocity * weight;
+                    ownDensity += weight * GetOwnCellDensity(grid, sample, offset);
+                    ownGradient += ownCellGradient * weight;
+                    ownVelocitySum += ownCellVelocity * weight;
+                }
+
+                //Friction weakens with less than a vertex worth of density around, as the push does
+                float otherDensity = density - ownDensity;
+                auto correction = (velocitySum - ownVelocitySum - velocity * otherDensity) * settings.hairFriction / (std::max)(otherDensity, 1.0f);
+
+                auto push = (ownGradient - gradient) / (std::max)(density, 1.0f);
+                float pushLength = push.Length();
+                if (pushLength > 1.0f) {
+                    push /= pushLength;
+                }
+                for (int k = 0; k < 3; k++) {
+                    position.m[k] += correction.m[k] + settings.volumeStiffness * push.m[k] * grid.cellSize.m[k];
+                }
+            }
+        });
+    }
+
+    void ReadBuffer(uint32_t bufferID, void* data, size_t size, size_t offset = 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, bufferID);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offset, size, data);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    void CPUSimulator::PrepareAssetData(const HairAsset* asset) const
+    {
+        if (asset->cpuData) {
+            return;
+        }
+
+        size_t verticesCount = asset->guidesCount * (asset->segmentsCount + 1);
+        auto cpuData = new HairAssetCPUData();
+        cpuData->restPositions.resize(verticesCount);
+        cpuData->tangentsDistances.resize(verticesCount);
+        cpuData->refVectors.resize(verticesCount);
+        cpuData->globalRotations.resize(verticesCount);
+
+        ReadBuffer(asset->restPositionsBufferID, cpuData->restPositions.data(), verticesCount * sizeof(Vector4));
+        ReadBuffer(asset->tangentsDistancesBufferID, cpuData->tangentsDistances.data(), verticesCount * sizeof(Vector4));
+        ReadBuffer(asset->refVectorsBufferID, cpuData->refVectors.data(), verticesCount * sizeof(Vector4));
+        ReadBuffer(asset->globalRotationsBufferID, cpuData->globalRotations.data(), verticesCount * sizeof(Quaternion));
+
+        asset->cpuData = cpuData;
+    }
+
+    void CPUSimulator::PreparePositions(HairInstance* instance) const
+    {
+        if (instance->cpuPositionsValid) {
+            return;
+        }
+
+        //The instance was created or simulated on the GPU since the last CPU step. CreateInstance fills
+        //both position buffers with the rest pose, so reading them back is right on the first step too.
+        size_t positionsSize = GetPositionsSize(instance);
+        size_t positionsOffset = GetPositionsOffset(instance);
+        instance->cpuPositions.resize(positionsSize / sizeof(Vector4));
+        instance->cpuPreviousPositions.resize(positionsSize / sizeof(Vector4));
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        ReadBuffer(GetPositionsBufferID(instance), instance->cpuPositions.data(), positionsSize, positionsOffset);
+        ReadBuffer(GetPreviousPositionsBufferID(instance), instance->cpuPreviousPositions.data(), positionsSize, positionsOffset);
+
+        instance->cpuPositionsValid = true;
+    }
+
+    void CPUSimulator::UploadPositions(const HairInstance* instance) const
+    {
+        size_t positionsSize = GetPositionsSize(instance);
+        size_t positionsOffset = GetPositionsOffset(instance);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, GetPositionsBufferID(instance));
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, positionsOffset, positionsSize, instance->cpuPositions.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, GetPreviousPositionsBufferID(instance));
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, positionsOffset, positionsSize, instance->cpuPreviousPositions.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+}
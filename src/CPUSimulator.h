@@ -0,0 +1,31 @@
+#ifndef HAIRGL_CPU_SIMULATOR_H
+#define HAIRGL_CPU_SIMULATOR_H
+
+#include <stdint.h>
+#include <vector>
+#include "Common.h"
+#include "ThreadPool.h"
+
+namespace HairGL
+{
+    class CPUSimulator
+    {
+    public:
+        CPUSimulator(ThreadPool& threadPool, uint32_t interactionGridResolution);
+        CPUSimulator(const CPUSimulator&) = delete;
+        void Simulate(HairInstance* instance, float timeStep) const;
+
+    private:
+        ThreadPool& threadPool;
+        uint32_t interactionGridResolution;
+        //Density and velocity sums of the hair interaction grid, kept between steps and cleared by each
+        mutable std::vector<int32_t> interactionCells;
+
+        void PrepareAssetData(const HairAsset* asset) const;
+        void PreparePositions(HairInstance* instance) const;
+        void UploadPositions(const HairInstance* instance) const;
+        void ApplyHairInteraction(HairInstance* instance) const;
+    };
+}
+
+#endif
@@ -1,18 +1,106 @@
 #include "Common.h"
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <stdio.h>
 
 namespace HairGL
 {
-    std::string LoadFile(const char* path)
+    bool TryLoadFile(const char* path, std::string& contents)
     {
         auto file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+
         fseek(file, 0, SEEK_END);
-        int size = ftell(file);
+        long size = ftell(file);
         fseek(file, 0, SEEK_SET);
 
-        std::string str(size, '\0');
-        fread(&str[0], 1, size, file);
+        contents.assign(size > 0 ? size : 0, '\0');
+        bool complete = size >= 0 && fread(&contents[0], 1, contents.size(), file) == contents.size();
         fclose(file);
 
-        return str;
+        return complete;
+    }
+
+    std::string LoadFile(const char* path)
+    {
+        std::string contents;
+        if (!TryLoadFile(path, contents)) {
+            throw std::runtime_error(std::string("Could not read file ") + path);
+        }
+        return contents;
+    }
+
+	Vector4 GetPyramidWindCorner(const Quaternion& rotationFromXToWind, const Vector3& axis, float angle, float magnitude)
+	{
+		Vector3 xAxis(1.0f, 0.0f, 0.0f);
+		Quaternion rotation(axis, angle);
+		auto side = rotationFromXToWind * rotation * xAxis * magnitude;
+		return Vector4(side.x, side.y, side.z, 0.0f);
+	}
+
+	Matrix4 CreateWindPyramid(const Vector3& wind, int frame)
+	{
+		float magnitude = wind.Length();
+		auto dir = wind / magnitude;
+		//magnitude *= (pow(sinf(frame * 0.00001f), 2.0f) + 0.5f);
+
+		Vector3 xAxis(1.0f, 0.0f, 0.0f);
+		auto rotationAxis = Vector3::Cross(xAxis, dir);
+		float angle = asin(rotationAxis.Length());
+
+		Quaternion rotationFromXToWind;
+		if (angle > 0.001)
+		{
+			rotationFromXToWind = Quaternion(rotationAxis.Normalized(), angle);
+		}
+
+		float coneAngle = 20.0f * DegToRad;
+
+		Matrix4 pyramid;
+		pyramid.m[0] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, 1, 0), coneAngle, magnitude);
+		pyramid.m[1] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, -1, 0), coneAngle, magnitude);
+		pyramid.m[2] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, 0, 1), coneAngle, magnitude);
+		pyramid.m[3] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, 0, -1), coneAngle, magnitude);
+
+		return pyramid;
+	}
+
+    SimulationParameters CreateSimulationParameters(const HairInstance* instance, float timeStep)
+    {
+        SimulationParameters parameters;
+        parameters.windPyramid = CreateWindPyramid(instance->settings.wind, instance->simulationFrame);
+        parameters.gravity = Vector3(0.0f, -9.8f, 0.0f);
+        parameters.timeStep = timeStep;
+        parameters.globalStiffness = instance->settings.globalStiffness;
+        parameters.localStiffness = (std::min)(instance->settings.localStiffness, 0.95f) * 0.5f;
+        parameters.damping = instance->settings.damping;
+        parameters.lengthConstraintIterations = 5;
+        parameters.localShapeIterations = 10;
+        return parameters;
+    }
+
+    bool HasSameSimulationSettings(const HairInstanceSettings& a, const HairInstanceSettings& b)
+    {
+        return a.globalStiffness == b.globalStiffness && a.localStiffness == b.localStiffness && a.damping == b.damping &&
+            a.wind.x == b.wind.x && a.wind.y == b.wind.y && a.wind.z == b.wind.z;
+    }
+
+    bool HasHairInteraction(const HairInstanceSettings& settings)
+    {
+        return settings.volumeStiffness > 0.0f || settings.hairFriction > 0.0f;
+    }
+
+    InteractionGrid GetInteractionGrid(const HairAsset* asset, uint32_t resolution)
+    {
+        InteractionGrid grid;
+        grid.origin = asset->reachBoundsMin;
+        grid.resolution = resolution;
+        for (int k = 0; k < 3; k++) {
+            grid.cellSize.m[k] = (std::max)((asset->reachBoundsMax.m[k] - asset->reachBoundsMin.m[k]) / resolution, 1e-6f);
+        }
+        return grid;
     }
-}
+}
\ No newline at end of file
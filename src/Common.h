@@ -4,9 +4,33 @@
 #include <stdint.h>
 #include <hairgl/HairTypes.h>
 #include <string>
+#include <vector>
 
 namespace HairGL
 {
+    struct HairAssetCPUData
+    {
+        std::vector<Vector4> restPositions;
+        std::vector<Vector4> tangentsDistances;
+        std::vector<Vector4> refVectors;
+        std::vector<Quaternion> globalRotations;
+    };
+
+    class HairInstance;
+
+    //Positions of every instance of an asset live in one pair of buffers, one slot per
+    //instance, so all instances of the asset can be simulated by a single dispatch. Each
+    //instance keeps its current positions in one buffer and its previous ones in the other.
+    struct HairInstancePool
+    {
+        uint32_t positionsBufferIDs[2];
+        uint32_t slotVerticesCount;
+        uint32_t capacity;
+        std::vector<HairInstance*> slots;
+        uint32_t simulationParamsBufferID;
+        uint32_t simulationParamsCapacity;
+    };
+
     class HairAsset
     {
     public:
@@ -19,6 +43,17 @@ namespace HairGL
         uint32_t segmentsCount;
         uint32_t guidesCount;
         uint32_t trianglesCount;
+        mutable HairAssetCPUData* cpuData;
+        mutable HairInstancePool instancePool;
+        std::string cacheKey;
+        mutable uint32_t referencesCount;
+        //Compact assets keep rest data as 16-bit values, positions relative to these bounds
+        bool compact;
+        Vector3 restBoundsMin;
+        Vector3 restBoundsSize;
+        //Everywhere the strands can reach, the hair interaction grid spans these bounds
+        Vector3 reachBoundsMin;
+        Vector3 reachBoundsMax;
     };
 
     class HairInstance
@@ -26,12 +61,66 @@ namespace HairGL
     public:
         const HairAsset* asset;
         HairInstanceSettings settings;
-        uint32_t positionsBufferID;
-        uint32_t previousPositionsBufferID;
+        uint32_t poolSlot;
+        //Pool buffer holding the current positions, a GPU step writes the other one and swaps them
+        uint32_t positionsBuffer;
 		uint32_t simulationFrame;
+        bool simulationParamsDirty;
+        std::vector<Vector4> cpuPositions;
+        std::vector<Vector4> cpuPreviousPositions;
+        bool cpuPositionsValid;
+        //Simulation time Advance has not run yet, and how far into the next step it is rendered
+        float timeAccumulator;
+        float interpolationFactor;
+        std::vector<HairCollider> colliders;
     };
 
+    struct SimulationParameters
+    {
+        Matrix4 windPyramid;
+        Vector3 gravity;
+        float timeStep;
+        float globalStiffness;
+        float localStiffness;
+        float damping;
+        int lengthConstraintIterations;
+        int localShapeIterations;
+    };
+
+    //Grid hair interaction is solved on, spanning everywhere the strands of the asset can reach
+    struct InteractionGrid
+    {
+        Vector3 origin;
+        Vector3 cellSize;
+        uint32_t resolution;
+    };
+
+    inline size_t GetPositionsOffset(const HairInstance* instance)
+    {
+        return (size_t)instance->poolSlot * instance->asset->instancePool.slotVerticesCount * sizeof(Vector4);
+    }
+
+    inline size_t GetPositionsSize(const HairInstance* instance)
+    {
+        return (size_t)instance->asset->guidesCount * (instance->asset->segmentsCount + 1) * sizeof(Vector4);
+    }
+
+    inline uint32_t GetPositionsBufferID(const HairInstance* instance)
+    {
+        return instance->asset->instancePool.positionsBufferIDs[instance->positionsBuffer];
+    }
+
+    inline uint32_t GetPreviousPositionsBufferID(const HairInstance* instance)
+    {
+        return instance->asset->instancePool.positionsBufferIDs[1 - instance->positionsBuffer];
+    }
+
+    bool TryLoadFile(const char* path, std::string& contents);
     std::string LoadFile(const char* path);
+    SimulationParameters CreateSimulationParameters(const HairInstance* instance, float timeStep);
+    bool HasSameSimulationSettings(const HairInstanceSettings& a, const HairInstanceSettings& b);
+    bool HasHairInteraction(const HairInstanceSettings& settings);
+    InteractionGrid GetInteractionGrid(const HairAsset* asset, uint32_t resolution);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,192 @@
+#include "CompactStorage.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace HairGL
+{
+    //Round to nearest even, like the conversions of the GPU
+    uint16_t FloatToHalf(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t exponent = (bits >> 23) & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (exponent == 0xFF) {
+            return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+        }
+
+        int32_t halfExponent = (int32_t)exponent - 127 + 15;
+        if (halfExponent >= 31) {
+            return sign | 0x7C00;
+        }
+
+        if (halfExponent <= 0) {
+            if (halfExponent < -10) {
+                return sign;
+            }
+            mantissa |= 0x800000;
+            uint32_t shift = 14 - halfExponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1))) {
+                half++;
+            }
+            return sign | half;
+        }
+
+        uint32_t half = (halfExponent << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    float HalfToFloat(uint16_t half)
+    {
+        uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1F;
+        uint32_t mantissa = half & 0x3FF;
+
+        float value;
+        if (exponent == 0) {
+            value = ldexpf((float)mantissa, -24);
+        }
+        else if (exponent == 31) {
+            value = mantissa ? NAN : INFINITY;
+        }
+        else {
+            value = ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+        }
+
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+        memcpy(&value, &bits, sizeof(bits));
+        return value;
+    }
+
+    uint16_t FloatToUnorm(float value)
+    {
+        return (uint16_t)roundf((std::min)((std::max)(value, 0.0f), 1.0f) * 65535.0f);
+    }
+
+    float UnormToFloat(uint16_t value)
+    {
+        return value / 65535.0f;
+    }
+
+    uint16_t FloatToSnorm(float value)
+    {
+        return (uint16_t)(int16_t)roundf((std::min)((std::max)(value, -1.0f), 1.0f) * 32767.0f);
+    }
+
+    float SnormToFloat(uint16_t value)
+    {
+        return (std::max)((int16_t)value / 32767.0f, -1.0f);
+    }
+
+    uint32_t Pack(uint16_t low, uint16_t high)
+    {
+        return (uint32_t)low | ((uint32_t)high << 16);
+    }
+
+    uint16_t Low(uint32_t value)
+    {
+        return value & 0xFFFF;
+    }
+
+    uint16_t High(uint32_t value)
+    {
+        return value >> 16;
+    }
+
+    void PackRestPositions(std::vector<Vector4>& positions, HairAssetCompactData& compactData)
+    {
+        Vector3 boundsMax;
+        if (!positions.empty()) {
+            compactData.boundsMin = Vector3(positions[0].x, positions[0].y, positions[0].z);
+            boundsMax = compactData.boundsMin;
+        }
+        for (auto& position : positions) {
+            for (int k = 0; k < 3; k++) {
+                compactData.boundsMin.m[k] = (std::min)(compactData.boundsMin.m[k], position.m[k]);
+                boundsMax.m[k] = (std::max)(boundsMax.m[k], position.m[k]);
+            }
+        }
+        compactData.boundsSize = boundsMax - compactData.boundsMin;
+
+        auto& boundsMin = compactData.boundsMin;
+        auto& boundsSize = compactData.boundsSize;
+        compactData.restPositions.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto& position = positions[i];
+            uint16_t offset[3];
+            for (int k = 0; k < 3; k++) {
+                offset[k] = boundsSize.m[k] > 0.0f ? FloatToUnorm((position.m[k] - boundsMin.m[k]) / boundsSize.m[k]) : 0;
+            }
+            auto& packed = compactData.restPositions[i];
+            packed.xy = Pack(offset[0], offset[1]);
+            packed.zw = Pack(offset[2], FloatToHalf(position.w));
+
+            position.x = boundsMin.x + UnormToFloat(offset[0]) * boundsSize.x;
+            position.y = boundsMin.y + UnormToFloat(offset[1]) * boundsSize.y;
+            position.z = boundsMin.z + UnormToFloat(offset[2]) * boundsSize.z;
+            position.w = HalfToFloat(High(packed.zw));
+        }
+    }
+
+    HairAssetCPUData* CreateCompactCPUData(HairAssetData& data)
+    {
+        auto cpuData = new HairAssetCPUData();
+        cpuData->restPositions = std::move(data.positions);
+        cpuData->tangentsDistances = std::move(data.tangentsDistances);
+        cpuData->refVectors = std::move(data.refVectors);
+        cpuData->globalRotations = std::move(data.globalRotations);
+        return cpuData;
+    }
+
+    void PackHairAssetData(HairAssetData& data, HairAssetCompactData& compactData)
+    {
+        PackRestPositions(data.positions, compactData);
+
+        compactData.tangentsDistances.resize(data.tangentsDistances.size());
+        for (size_t i = 0; i < data.tangentsDistances.size(); i++) {
+            auto& tangentDistance = data.tangentsDistances[i];
+            auto& packed = compactData.tangentsDistances[i];
+            packed.xy = Pack(FloatToSnorm(tangentDistance.x), FloatToSnorm(tangentDistance.y));
+            packed.zw = Pack(FloatToSnorm(tangentDistance.z), FloatToHalf(tangentDistance.w));
+            tangentDistance = Vector4(SnormToFloat(Low(packed.xy)), SnormToFloat(High(packed.xy)), SnormToFloat(Low(packed.zw)), HalfToFloat(High(packed.zw)));
+        }
+
+        compactData.refVectors.resize(data.refVectors.size());
+        for (size_t i = 0; i < data.refVectors.size(); i++) {
+            auto& refVector = data.refVectors[i];
+            auto& packed = compactData.refVectors[i];
+            packed.xy = Pack(FloatToHalf(refVector.x), FloatToHalf(refVector.y));
+            packed.zw = Pack(FloatToHalf(refVector.z), FloatToHalf(refVector.w));
+            refVector = Vector4(HalfToFloat(Low(packed.xy)), HalfToFloat(High(packed.xy)), HalfToFloat(Low(packed.zw)), HalfToFloat(High(packed.zw)));
+        }
+
+        //Rotations are normalized again after decoding, on the GPU as well
+        compactData.globalRotations.resize(data.globalRotations.size());
+        for (size_t i = 0; i < data.globalRotations.size(); i++) {
+            auto& rotation = data.globalRotations[i];
+            auto& packed = compactData.globalRotations[i];
+            packed.xy = Pack(FloatToSnorm(rotation.x), FloatToSnorm(rotation.y));
+            packed.zw = Pack(FloatToSnorm(rotation.z), FloatToSnorm(rotation.w));
+
+            float x = SnormToFloat(Low(packed.xy));
+            float y = SnormToFloat(High(packed.xy));
+            float z = SnormToFloat(Low(packed.zw));
+            float w = SnormToFloat(High(packed.zw));
+            float length = sqrtf(x * x + y * y + z * z + w * w);
+            rotation = length > 0.0f ? Quaternion(x / length, y / length, z / length, w / length) : Quaternion();
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef HAIRGL_COMPACT_STORAGE_H
+#define HAIRGL_COMPACT_STORAGE_H
+
+#include <stdint.h>
+#include <hairgl/Math.h>
+#include <vector>
+#include "HairAssetFile.h"
+#include "Common.h"
+
+namespace HairGL
+{
+    //Four 16-bit values, read by the shaders as one uvec2
+    struct PackedVector4
+    {
+        uint32_t xy;
+        uint32_t zw;
+    };
+
+    //Rest data in the layout of the compact GPU buffers. Positions are unorm16 offsets into the
+    //bounds of the asset with w as a half, tangents and rotations are snorm16, distances and
+    //reference vectors are halfs.
+    struct HairAssetCompactData
+    {
+        Vector3 boundsMin;
+        Vector3 boundsSize;
+        std::vector<PackedVector4> restPositions;
+        std::vector<PackedVector4> tangentsDistances;
+        std::vector<PackedVector4> refVectors;
+        std::vector<PackedVector4> globalRotations;
+    };
+
+    //Packs the rest data of the asset, then replaces it with what the shaders decode from the
+    //packed data, so everything still using the full precision copy sees the same values
+    void PackHairAssetData(HairAssetData& data, HairAssetCompactData& compactData);
+    //Compact buffers can't be read back as floats, so the CPU simulation, new instances and
+    //SaveAsset use the decoded rest data moved out of data instead
+    HairAssetCPUData* CreateCompactCPUData(HairAssetData& data);
+}
+
+#endif
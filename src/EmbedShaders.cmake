@@ -0,0 +1,40 @@
+#Writes OUTPUT_FILE, a translation unit with the contents of SHADER_FILES (relative to SOURCE_DIR)
+#as the EmbeddedShaders table declared in ShaderSources.h. Run with cmake -P.
+
+#CMake regular expressions have no counted repetition, so a line of 16 bytes is spelled out
+set(SHADER_LINE_REGEX "")
+foreach(I RANGE 1 16)
+	set(SHADER_LINE_REGEX "${SHADER_LINE_REGEX}0x[0-9a-f][0-9a-f],")
+endforeach()
+
+set(SHADER_DATA "")
+set(SHADER_TABLE "")
+
+foreach(SHADER_FILE ${SHADER_FILES})
+	get_filename_component(SHADER_NAME "${SHADER_FILE}" NAME)
+	string(MAKE_C_IDENTIFIER "${SHADER_NAME}" SHADER_ID)
+	file(READ "${SOURCE_DIR}/${SHADER_FILE}" SHADER_HEX HEX)
+	string(LENGTH "${SHADER_HEX}" SHADER_HEX_LENGTH)
+	math(EXPR SHADER_LENGTH "${SHADER_HEX_LENGTH} / 2")
+	string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," SHADER_BYTES "${SHADER_HEX}")
+	string(REGEX REPLACE "(${SHADER_LINE_REGEX})" "\\1\n        " SHADER_BYTES "${SHADER_BYTES}")
+	string(APPEND SHADER_DATA "    static const unsigned char ${SHADER_ID}[] = {\n        ${SHADER_BYTES}0x00\n    };\n\n")
+	string(APPEND SHADER_TABLE "        { \"${SHADER_NAME}\", reinterpret_cast<const char*>(${SHADER_ID}), ${SHADER_LENGTH} },\n")
+endforeach()
+
+list(LENGTH SHADER_FILES SHADERS_COUNT)
+
+file(WRITE "${OUTPUT_FILE}.tmp"
+"//Generated by EmbedShaders.cmake from src/shaders, do not edit\n"
+"#include \"ShaderSources.h\"\n\n"
+"namespace HairGL\n{\n"
+"${SHADER_DATA}"
+"    const EmbeddedShader EmbeddedShaders[] = {\n"
+"${SHADER_TABLE}"
+"    };\n\n"
+"    const size_t EmbeddedShadersCount = ${SHADERS_COUNT};\n"
+"}\n")
+
+#Only touch the output when a shader changed, so unrelated builds don't recompile it
+configure_file("${OUTPUT_FILE}.tmp" "${OUTPUT_FILE}" COPYONLY)
+file(REMOVE "${OUTPUT_FILE}.tmp")
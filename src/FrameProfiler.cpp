@@ -0,0 +1,195 @@
+#include "FrameProfiler.h"
+#include "gl/GLUtils.h"
+
+namespace HairGL
+{
+    //Frames whose queries are still pending before the oldest one is waited for
+    constexpr size_t MaxPendingFrames = 4;
+
+    FrameProfiler::FrameProfiler() :
+        enabled(false),
+        queryActive(false),
+        frameIndex(0),
+        latestStats()
+    {
+        currentFrame.stats = {};
+    }
+
+    void FrameProfiler::SetEnabled(bool enabled)
+    {
+        this->enabled = enabled;
+    }
+
+    bool FrameProfiler::IsEnabled() const
+    {
+        return enabled;
+    }
+
+    HairInstanceStats& FrameProfiler::GetInstanceStats(Frame& frame, const HairInstance* instance)
+    {
+        auto index = frame.instanceIndices.find(instance);
+        if (index != frame.instanceIndices.end()) {
+            return frame.stats.instances[index->second];
+        }
+
+        HairInstanceStats instanceStats = {};
+        instanceStats.instance = instance;
+        frame.instanceIndices[instance] = frame.stats.instances.size();
+        frame.stats.instances.push_back(instanceStats);
+        return frame.stats.instances.back();
+    }
+
+    void FrameProfiler::BeginGPUQuery(GPUScope scope, const HairInstance* const* instances, size_t count)
+    {
+        if (!enabled) {
+            return;
+        }
+
+        GPUQuery query;
+        if (freeQueryIDs.empty()) {
+            glGenQueries(1, &query.queryID);
+        }
+        else {
+            query.queryID = freeQueryIDs.back();
+            freeQueryIDs.pop_back();
+        }
+        query.scope = scope;
+        query.instances.assign(instances, instances + count);
+
+        glBeginQuery(GL_TIME_ELAPSED, query.queryID);
+        currentFrame.queries.push_back(std::move(query));
+        queryActive = true;
+    }
+
+    void FrameProfiler::EndGPUQuery()
+    {
+        if (!queryActive) {
+            return;
+        }
+
+        glEndQuery(GL_TIME_ELAPSED);
+        queryActive = false;
+    }
+
+    void FrameProfiler::AddSimulationCPUTime(const HairInstance* instance, double time)
+    {
+        if (!enabled) {
+            return;
+        }
+
+        currentFrame.stats.simulationCPUTime += time;
+        GetInstanceStats(currentFrame, instance).simulationCPUTime += time;
+    }
+
+    void FrameProfiler::AddRenderCPUTime(const HairInstance* instance, double time)
+    {
+        if (!enabled) {
+            return;
+        }
+
+        currentFrame.stats.renderCPUTime += time;
+        GetInstanceStats(currentFrame, instance).renderCPUTime += time;
+    }
+
+    bool FrameProfiler::IsFrameAvailable(const Frame& frame) const
+    {
+        //Queries finish in submission order, so the last one decides for the whole frame
+        if (frame.queries.empty()) {
+            return true;
+        }
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(frame.queries.back().queryID, GL_QUERY_RESULT_AVAILABLE, &available);
+        return available == GL_TRUE;
+    }
+
+    void FrameProfiler::ResolveFrame(Frame& frame)
+    {
+        for (auto& query : frame.queries) {
+            GLuint64 elapsedNanoseconds = 0;
+            glGetQueryObjectui64v(query.queryID, GL_QUERY_RESULT, &elapsedNanoseconds);
+            freeQueryIDs.push_back(query.queryID);
+
+            double time = elapsedNanoseconds / 1000000.0;
+            double instanceTime = query.instances.empty() ? 0.0 : time / query.instances.size();
+
+            for (auto instance : query.instances) {
+                auto& instanceStats = GetInstanceStats(frame, instance);
+                switch (query.scope) {
+                case GPUScope::Simulation:
+                    instanceStats.simulationGPUTime += instanceTime;
+                    break;
+                case GPUScope::Culling:
+                    instanceStats.cullingGPUTime += instanceTime;
+                    break;
+                case GPUScope::Guides:
+                    instanceStats.guidesGPUTime += instanceTime;
+                    break;
+                case GPUScope::GrowthMesh:
+                    instanceStats.growthMeshGPUTime += instanceTime;
+                    break;
+                case GPUScope::Hair:
+                    instanceStats.hairGPUTime += instanceTime;
+                    break;
+                }
+            }
+
+            switch (query.scope) {
+            case GPUScope::Simulation:
+                frame.stats.simulationGPUTime += time;
+                break;
+            case GPUScope::Culling:
+                frame.stats.cullingGPUTime += time;
+                break;
+            case GPUScope::Guides:
+                frame.stats.guidesGPUTime += time;
+                break;
+            case GPUScope::GrowthMesh:
+                frame.stats.growthMeshGPUTime += time;
+                break;
+            case GPUScope::Hair:
+                frame.stats.hairGPUTime += time;
+                break;
+            }
+        }
+
+        latestStats = std::move(frame.stats);
+    }
+
+    void FrameProfiler::EndFrame()
+    {
+        if (enabled) {
+            currentFrame.stats.frameIndex = frameIndex;
+            pendingFrames.push_back(std::move(currentFrame));
+            currentFrame = Frame();
+            currentFrame.stats = {};
+        }
+        frameIndex++;
+
+        while (!pendingFrames.empty() && (pendingFrames.size() > MaxPendingFrames || IsFrameAvailable(pendingFrames.front()))) {
+            ResolveFrame(pendingFrames.front());
+            pendingFrames.pop_front();
+        }
+    }
+
+    const HairFrameStats& FrameProfiler::GetLatestStats() const
+    {
+        return latestStats;
+    }
+
+    FrameProfiler::~FrameProfiler()
+    {
+        for (auto& frame : pendingFrames) {
+            for (auto& query : frame.queries) {
+                freeQueryIDs.push_back(query.queryID);
+            }
+        }
+        for (auto& query : currentFrame.queries) {
+            freeQueryIDs.push_back(query.queryID);
+        }
+
+        if (!freeQueryIDs.empty()) {
+            glDeleteQueries(freeQueryIDs.size(), freeQueryIDs.data());
+        }
+    }
+}
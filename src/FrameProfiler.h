@@ -0,0 +1,75 @@
+#ifndef HAIRGL_FRAME_PROFILER_H
+#define HAIRGL_FRAME_PROFILER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <hairgl/HairTypes.h>
+
+namespace HairGL
+{
+    typedef std::chrono::steady_clock ProfilerClock;
+
+    inline double GetElapsedTime(ProfilerClock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(ProfilerClock::now() - start).count();
+    }
+
+    enum class GPUScope
+    {
+        Simulation,
+        Culling,
+        Guides,
+        GrowthMesh,
+        Hair
+    };
+
+    //Collects GL_TIME_ELAPSED queries and CPU times of a frame. Queries are read back a few
+    //frames later, once they are available, so collecting stats does not stall the pipeline.
+    class FrameProfiler
+    {
+    public:
+        FrameProfiler();
+        FrameProfiler(const FrameProfiler&) = delete;
+        void SetEnabled(bool enabled);
+        bool IsEnabled() const;
+        void BeginGPUQuery(GPUScope scope, const HairInstance* const* instances, size_t count);
+        void EndGPUQuery();
+        void AddSimulationCPUTime(const HairInstance* instance, double time);
+        void AddRenderCPUTime(const HairInstance* instance, double time);
+        void EndFrame();
+        const HairFrameStats& GetLatestStats() const;
+        ~FrameProfiler();
+
+    private:
+        struct GPUQuery
+        {
+            uint32_t queryID;
+            GPUScope scope;
+            std::vector<const HairInstance*> instances;
+        };
+
+        struct Frame
+        {
+            HairFrameStats stats;
+            std::vector<GPUQuery> queries;
+            std::unordered_map<const HairInstance*, size_t> instanceIndices;
+        };
+
+        bool enabled;
+        bool queryActive;
+        uint64_t frameIndex;
+        Frame currentFrame;
+        std::deque<Frame> pendingFrames;
+        std::vector<uint32_t> freeQueryIDs;
+        HairFrameStats latestStats;
+
+        HairInstanceStats& GetInstanceStats(Frame& frame, const HairInstance* instance);
+        bool IsFrameAvailable(const Frame& frame) const;
+        void ResolveFrame(Frame& frame);
+    };
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include "HairAssetFile.h"
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace HairGL
+{
+    void ParseHairAssetFileV1(const uint8_t* data, size_t size, const char* path, HairAssetFileView& view)
+    {
+        int32_t counts[3];
+        if (size < sizeof(counts)) {
+            throw std::runtime_error(std::string("Invalid hair asset file ") + path);
+        }
+        memcpy(counts, data, sizeof(counts));
+
+        view.version = 1;
+        view.guidesCount = counts[0];
+        view.segmentsCount = counts[1];
+        view.trianglesCount = counts[2];
+
+        size_t positionsSize = view.GetVerticesCount() * sizeof(float) * 3;
+        size_t trianglesSize = (size_t)view.trianglesCount * sizeof(int32_t) * 3;
+        if (counts[0] < 0 || counts[1] < 0 || counts[2] < 0 || size < sizeof(counts) + positionsSize + trianglesSize) {
+            throw std::runtime_error(std::string("Invalid hair asset file ") + path);
+        }
+
+        view.positions = data + sizeof(counts);
+        view.triangles = view.positions + positionsSize;
+    }
+
+    void ParseHairAssetFileV2(const uint8_t* data, size_t size, const char* path, HairAssetFileView& view)
+    {
+        HairAssetFileHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error(std::string("Invalid hair asset file ") + path);
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (header.version != HairAssetFileVersion) {
+            throw std::runtime_error(std::string("Unsupported hair asset file version ") + path);
+        }
+
+        if (size < sizeof(header) + (size_t)header.sectionsCount * sizeof(HairAssetFileSection)) {
+            throw std::runtime_error(std::string("Invalid hair asset file ") + path);
+        }
+
+        view.version = header.version;
+        view.guidesCount = header.guidesCount;
+        view.segmentsCount = header.segmentsCount;
+        view.trianglesCount = header.trianglesCount;
+
+        size_t verticesCount = view.GetVerticesCount();
+        size_t expectedSizes[(size_t)HairAssetSectionType::Count] = {
+            verticesCount * sizeof(Vector4),
+            (size_t)header.trianglesCount * sizeof(int32_t) * 4,
+            verticesCount * sizeof(Vector4),
+            verticesCount * sizeof(Vector4),
+            verticesCount * sizeof(Quaternion)
+        };
+
+        const uint8_t* sectionsData[(size_t)HairAssetSectionType::Count] = {};
+
+        for (uint32_t i = 0; i < header.sectionsCount; i++) {
+            HairAssetFileSection section;
+            memcpy(&section, data + sizeof(header) + i * sizeof(section), sizeof(section));
+
+            //Unknown sections are skipped so newer writers stay readable
+            if (section.type >= HairAssetSectionType::Count) {
+                continue;
+            }
+
+            if (section.size != expectedSizes[(size_t)section.type] || section.offset > size || section.size > size - section.offset ||
+                section.offset % sizeof(Vector4) != 0) {
+                throw std::runtime_error(std::string("Invalid section in hair asset file ") + path);
+            }
+
+            sectionsData[(size_t)section.type] = data + section.offset;
+        }
+
+        view.positions = sectionsData[(size_t)HairAssetSectionType::Positions];
+        view.triangles = sectionsData[(size_t)HairAssetSectionType::Triangles];
+        view.tangentsDistances = reinterpret_cast<const Vector4*>(sectionsData[(size_t)HairAssetSectionType::TangentsDistances]);
+        view.refVectors = reinterpret_cast<const Vector4*>(sectionsData[(size_t)HairAssetSectionType::RefVectors]);
+        view.globalRotations = reinterpret_cast<const Quaternion*>(sectionsData[(size_t)HairAssetSectionType::GlobalRotations]);
+
+        if (view.positions == nullptr || view.triangles == nullptr) {
+            throw std::runtime_error(std::string("Missing sections in hair asset file ") + path);
+        }
+    }
+
+    void ParseHairAssetFile(const uint8_t* data, size_t size, const char* path, HairAssetFileView& view)
+    {
+        view = {};
+
+        uint32_t magic = 0;
+        if (size >= sizeof(magic)) {
+            memcpy(&magic, data, sizeof(magic));
+        }
+
+        if (magic == HairAssetFileMagic) {
+            ParseHairAssetFileV2(data, size, path, view);
+        }
+        else {
+            ParseHairAssetFileV1(data, size, path, view);
+        }
+    }
+
+    void CopyPositions(const HairAssetFileView& view, Vector4* positions)
+    {
+        size_t verticesCount = view.GetVerticesCount();
+
+        if (view.version != 1) {
+            memcpy(positions, view.positions, verticesCount * sizeof(Vector4));
+            return;
+        }
+
+        //Version 1 stores xyz only, roots are marked as immovable through w
+        uint32_t verticesPerStrand = view.segmentsCount + 1;
+        auto source = reinterpret_cast<const float*>(view.positions);
+        for (size_t i = 0; i < verticesCount; i++) {
+            positions[i] = Vector4(source[i * 3], source[i * 3 + 1], source[i * 3 + 2], i % verticesPerStrand == 0 ? 0.0f : 1.0f);
+        }
+    }
+
+    void CopyTriangles(const HairAssetFileView& view, int32_t* triangles)
+    {
+        if (view.version != 1) {
+            memcpy(triangles, view.triangles, (size_t)view.trianglesCount * sizeof(int32_t) * 4);
+            return;
+        }
+
+        auto source = reinterpret_cast<const int32_t*>(view.triangles);
+        for (size_t i = 0; i < view.trianglesCount; i++) {
+            triangles[i * 4] = source[i * 3];
+            triangles[i * 4 + 1] = source[i * 3 + 1];
+            triangles[i * 4 + 2] = source[i * 3 + 2];
+            triangles[i * 4 + 3] = 0;
+        }
+    }
+
+    void ReadHairAssetData(const HairAssetFileView& view, HairAssetData& data, ThreadPool* threadPool)
+    {
+        size_t verticesCount = view.GetVerticesCount();
+        int verticesPerStrand = view.segmentsCount + 1;
+
+        data.guidesCount = view.guidesCount;
+        data.segmentsCount = view.segmentsCount;
+        data.trianglesCount = view.trianglesCount;
+
+        data.positions.resize(verticesCount);
+        data.triangles.resize((size_t)view.trianglesCount * 4);
+        data.tangentsDistances.resize(verticesCount);
+        data.refVectors.resize(verticesCount);
+        data.globalRotations.resize(verticesCount);
+
+        if (verticesCount == 0) {
+            return;
+        }
+
+        CopyPositions(view, data.positions.data());
+        CopyTriangles(view, data.triangles.data());
+        CalculateReachBounds(view.GetPositions(), view.guidesCount, verticesPerStrand, data.reachBoundsMin, data.reachBoundsMax);
+
+        if (view.HasConstraints()) {
+            memcpy(data.tangentsDistances.data(), view.tangentsDistances, verticesCount * sizeof(Vector4));
+            memcpy(data.refVectors.data(), view.refVectors, verticesCount * sizeof(Vector4));
+            memcpy(data.globalRotations.data(), view.globalRotations, verticesCount * sizeof(Quaternion));
+        }
+        else {
+            CalculateConstraints(view.GetPositions(), view.guidesCount, verticesPerStrand, data.tangentsDistances.data(), threadPool);
+            CalculateRotations(view.GetPositions(), view.guidesCount, verticesPerStrand, data.globalRotations.data(), data.refVectors.data(), threadPool);
+        }
+    }
+
+    uint64_t AlignOffset(uint64_t offset)
+    {
+        return (offset + HairAssetFileAlignment - 1) / HairAssetFileAlignment * HairAssetFileAlignment;
+    }
+
+    void WriteHairAssetFile(const char* path, const HairAssetData& data)
+    {
+        struct SectionSource
+        {
+            HairAssetSectionType type;
+            const void* data;
+            uint64_t size;
+        };
+
+        std::vector<SectionSource> sources = {
+            { HairAssetSectionType::Positions, data.positions.data(), data.positions.size() * sizeof(Vector4) },
+            { HairAssetSectionType::Triangles, data.triangles.data(), data.triangles.size() * sizeof(int32_t) }
+        };
+
+        if (data.HasConstraints()) {
+            sources.push_back({ HairAssetSectionType::TangentsDistances, data.tangentsDistances.data(), data.tangentsDistances.size() * sizeof(Vector4) });
+            sources.push_back({ HairAssetSectionType::RefVectors, data.refVectors.data(), data.refVectors.size() * sizeof(Vector4) });
+            sources.push_back({ HairAssetSectionType::GlobalRotations, data.globalRotations.data(), data.globalRotations.size() * sizeof(Quaternion) });
+        }
+
+        HairAssetFileHeader header = {};
+        header.magic = HairAssetFileMagic;
+        header.version = HairAssetFileVersion;
+        header.guidesCount = data.guidesCount;
+        header.segmentsCount = data.segmentsCount;
+        header.trianglesCount = data.trianglesCount;
+        header.sectionsCount = sources.size();
+        header.alignment = HairAssetFileAlignment;
+
+        std::vector<HairAssetFileSection> sections(sources.size());
+        uint64_t offset = AlignOffset(sizeof(header) + sections.size() * sizeof(HairAssetFileSection));
+        for (size_t i = 0; i < sources.size(); i++) {
+            sections[i].type = sources[i].type;
+            sections[i].reserved = 0;
+            sections[i].offset = offset;
+            sections[i].size = sources[i].size;
+            offset = AlignOffset(offset + sources[i].size);
+        }
+
+        auto file = fopen(path, "wb");
+        if (file == nullptr) {
+            throw std::runtime_error(std::string("Cannot open file ") + path);
+        }
+
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(sections.data(), sizeof(HairAssetFileSection), sections.size(), file);
+
+        static const char padding[HairAssetFileAlignment] = {};
+        for (size_t i = 0; i < sources.size(); i++) {
+            long position = ftell(file);
+            fwrite(padding, 1, sections[i].offset - position, file);
+            fwrite(sources[i].data, 1, sources[i].size, file);
+        }
+
+        bool failed = ferror(file) != 0;
+        fclose(file);
+
+        if (failed) {
+            throw std::runtime_error(std::string("Cannot write hair asset file ") + path);
+        }
+    }
+}
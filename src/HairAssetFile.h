@@ -0,0 +1,125 @@
+#ifndef HAIRGL_HAIR_ASSET_FILE_H
+#define HAIRGL_HAIR_ASSET_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hairgl/Math.h>
+#include <vector>
+
+namespace HairGL
+{
+    class ThreadPool;
+
+    //Version 1 files have no header: guides, segments and triangles counts followed by
+    //xyz positions and xyz triangle indices. Version 2 files start with a header and a
+    //section table, every section holds data in the same layout as its GPU buffer.
+    constexpr uint32_t HairAssetFileMagic = 0x464C4748; //"HGLF"
+    constexpr uint32_t HairAssetFileVersion = 2;
+    constexpr uint32_t HairAssetFileAlignment = 256;
+
+    enum class HairAssetSectionType : uint32_t
+    {
+        Positions,
+        Triangles,
+        TangentsDistances,
+        RefVectors,
+        GlobalRotations,
+        Count
+    };
+
+    struct HairAssetFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t guidesCount;
+        uint32_t segmentsCount;
+        uint32_t trianglesCount;
+        uint32_t sectionsCount;
+        uint32_t alignment;
+        uint32_t reserved;
+    };
+
+    struct HairAssetFileSection
+    {
+        HairAssetSectionType type;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct HairAssetData
+    {
+        uint32_t guidesCount;
+        uint32_t segmentsCount;
+        uint32_t trianglesCount;
+        std::vector<Vector4> positions;
+        std::vector<int32_t> triangles;
+        std::vector<Vector4> tangentsDistances;
+        std::vector<Vector4> refVectors;
+        std::vector<Quaternion> globalRotations;
+        Vector3 reachBoundsMin;
+        Vector3 reachBoundsMax;
+
+        bool HasConstraints() const
+        {
+            return !tangentsDistances.empty();
+        }
+    };
+
+    struct StridedPositions
+    {
+        const uint8_t* data;
+        size_t stride;
+
+        Vector3 operator[](size_t i) const
+        {
+            auto position = reinterpret_cast<const float*>(data + i * stride);
+            return Vector3(position[0], position[1], position[2]);
+        }
+    };
+
+    //Read-only view of a memory mapped asset file, sections point into the mapping
+    struct HairAssetFileView
+    {
+        uint32_t version;
+        uint32_t guidesCount;
+        uint32_t segmentsCount;
+        uint32_t trianglesCount;
+        const uint8_t* positions;
+        const uint8_t* triangles;
+        const Vector4* tangentsDistances;
+        const Vector4* refVectors;
+        const Quaternion* globalRotations;
+
+        size_t GetVerticesCount() const
+        {
+            return (size_t)guidesCount * (segmentsCount + 1);
+        }
+
+        StridedPositions GetPositions() const
+        {
+            return { positions, version == 1 ? sizeof(float) * 3 : sizeof(Vector4) };
+        }
+
+        bool HasConstraints() const
+        {
+            return tangentsDistances != nullptr && refVectors != nullptr && globalRotations != nullptr;
+        }
+    };
+
+    void ParseHairAssetFile(const uint8_t* data, size_t size, const char* path, HairAssetFileView& view);
+    void CopyPositions(const HairAssetFileView& view, Vector4* positions);
+    void CopyTriangles(const HairAssetFileView& view, int32_t* triangles);
+    //Copies the whole asset out of the mapping, computing the constraint data version 1 files lack
+    void ReadHairAssetData(const HairAssetFileView& view, HairAssetData& data, ThreadPool* threadPool = nullptr);
+    //Constraint data of version 1 files, spread over threadPool when one is given. Rotations are
+    //computed for several strands at once and match the scalar quaternion math up to rounding.
+    void CalculateConstraints(const StridedPositions& vertices, uint32_t guidesCount, int verticesPerStrand, Vector4* tangentsDistances, ThreadPool* threadPool = nullptr);
+    void CalculateRotations(const StridedPositions& vertices, uint32_t guidesCount, int verticesPerStrand, Quaternion* globalRotations, Vector4* refVectors, ThreadPool* threadPool = nullptr);
+    //Roots don't move, so no vertex gets further from its root than the length of its strand.
+    //The bounds of every root grown by the length of its own strand hold the hair in any simulated pose.
+    void CalculateReachBounds(const StridedPositions& vertices, uint32_t guidesCount, int verticesPerStrand, Vector3& boundsMin, Vector3& boundsMax);
+    void WriteHairAssetFile(const char* path, const HairAssetData& data);
+}
+
+#endif
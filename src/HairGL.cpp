@@ -1,235 +1,719 @@
 #include <hairgl/HairGL.h>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
+#include <memory>
 #include "gl/GLUtils.h"
 #include "Renderer.h"
+#include "ThreadPool.h"
+#include "CPUSimulator.h"
+#include "FrameProfiler.h"
+#include "HairAssetFile.h"
+#include "MappedFile.h"
+#include "AssetLoader.h"
+#include "AssetCache.h"
+#include "CompactStorage.h"
+#include <string.h>
+#include <math.h>
 
 namespace HairGL
 {
-    HairSystem::HairSystem() :
-        renderer(nullptr)
+    HairSystem::HairSystem(const HairSystemSettings& settings) :
+        settings(settings),
+        renderer(nullptr),
+        threadPool(nullptr),
+        cpuSimulator(nullptr),
+        profiler(nullptr),
+        assetLoader(nullptr),
+        assetCache(nullptr)
     {
         if (!InitGL()) {
             throw std::runtime_error("Cannot intitialize OpenGL resources.");
         }
 
-        renderer = new Renderer();
+        profiler = new FrameProfiler();
+        renderer = new Renderer(*profiler, settings);
+        threadPool = new ThreadPool();
+        cpuSimulator = new CPUSimulator(*threadPool, settings.interactionGridResolution);
+        assetLoader = new AssetLoader(settings.maxStrandVertices, settings.assetUploadBudget, settings.compactStorage);
+        assetCache = new AssetCache();
     }
 
     void HairSystem::Simulate(HairInstance* instance, float timeStep) const
     {
-        renderer->Simulate(instance, timeStep);
+        Simulate(&instance, 1, timeStep);
     }
 
-    void HairSystem::Render(const HairInstance* instance, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const
+    void HairSystem::Simulate(HairInstance* const* instances, size_t count, float timeStep) const
     {
-        renderer->Render(instance, viewMatrix, projectionMatrix);
+        std::vector<HairInstance*> gpuInstances;
+        gpuInstances.reserve(count);
+
+        for (size_t i = 0; i < count; i++) {
+            instances[i]->interpolationFactor = 1.0f;
+            if (instances[i]->settings.simulationBackend == SimulationBackend::CPU) {
+                auto start = ProfilerClock::now();
+                cpuSimulator->Simulate(instances[i], timeStep);
+                profiler->AddSimulationCPUTime(instances[i], GetElapsedTime(start));
+            }
+            else {
+                gpuInstances.push_back(instances[i]);
+                instances[i]->cpuPositionsValid = false;
+            }
+        }
+
+        if (!gpuInstances.empty()) {
+            auto start = ProfilerClock::now();
+            renderer->Simulate(gpuInstances.data(), gpuInstances.size(), timeStep);
+
+            //A batch is submitted at once, so its CPU time is split evenly like its GPU time
+            double instanceTime = GetElapsedTime(start) / gpuInstances.size();
+            for (auto instance : gpuInstances) {
+                profiler->AddSimulationCPUTime(instance, instanceTime);
+            }
+        }
     }
 
-    void CalculateConstraints(const std::vector<Vector4>& vertices, int verticesPerStrand, std::vector<Vector4>& tangentsDistances)
+    uint32_t HairSystem::Advance(HairInstance* instance, float frameTime) const
     {
-        tangentsDistances.resize(vertices.size());
+        return Advance(&instance, 1, frameTime);
+    }
 
-        for (int guideIndex = 0; guideIndex < vertices.size() / verticesPerStrand; guideIndex++) {
-            for (int i = 0; i < verticesPerStrand - 1; i++) {
-                auto p0 = vertices[guideIndex * verticesPerStrand + i];
-                auto p1 = vertices[guideIndex * verticesPerStrand + i + 1];
+    uint32_t HairSystem::Advance(HairInstance* const* instances, size_t count, float frameTime) const
+    {
+        float fixedTimeStep = settings.fixedTimeStep;
+        std::vector<uint32_t> stepsCounts(count);
+        uint32_t maxStepsCount = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            auto instance = instances[i];
+            instance->timeAccumulator += (std::max)(frameTime, 0.0f);
+            uint32_t stepsCount = (std::min)((uint32_t)(instance->timeAccumulator / fixedTimeStep), settings.maxSubsteps);
+            instance->timeAccumulator -= stepsCount * fixedTimeStep;
+
+            //Time past the cap is dropped, otherwise a slow frame makes the next one slower still
+            if (stepsCount == settings.maxSubsteps) {
+                instance->timeAccumulator = (std::min)(instance->timeAccumulator, fixedTimeStep);
+            }
+
+            stepsCounts[i] = stepsCount;
+            maxStepsCount = (std::max)(maxStepsCount, stepsCount);
+        }
 
-                tangentsDistances[guideIndex * verticesPerStrand + i].w = (p1.XYZ() - p0.XYZ()).Length();
+        //Instances that need the same step are simulated together, so GPU instances still share dispatches
+        std::vector<HairInstance*> stepInstances;
+        stepInstances.reserve(count);
+        for (uint32_t step = 0; step < maxStepsCount; step++) {
+            stepInstances.clear();
+            for (size_t i = 0; i < count; i++) {
+                if (stepsCounts[i] > step) {
+                    stepInstances.push_back(instances[i]);
+                }
             }
+            Simulate(stepInstances.data(), stepInstances.size(), fixedTimeStep);
         }
-    }
 
-	void CalculateRotations(const std::vector<Vector4>& vertices, int verticesPerStrand, std::vector<Quaternion>& globalRotations, std::vector<Vector4>& refVectors)
-	{
-		std::vector<Quaternion> localRotations(vertices.size());
-		globalRotations.resize(vertices.size());
-		refVectors.resize(vertices.size());
+        for (size_t i = 0; i < count; i++) {
+            instances[i]->interpolationFactor = instances[i]->timeAccumulator / fixedTimeStep;
+        }
 
-		for (int guideIndex = 0; guideIndex < vertices.size() / verticesPerStrand; guideIndex++) {
-			int rootVertexIndex = guideIndex * verticesPerStrand;
+        return maxStepsCount;
+    }
+
+    void HairSystem::Render(const HairInstance* instance, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const
+    {
+        renderer->Render(&instance, 1, viewMatrix, projectionMatrix);
+    }
 
-			auto position = vertices[rootVertexIndex].XYZ();
-			auto positionNext = vertices[rootVertexIndex + 1].XYZ();
-			auto tangent = positionNext - position;
-			auto xAxis = tangent.Normalized();
-			auto zAxis = Vector3::Cross(xAxis, Vector3(1.0f, 0, 0));
+    void HairSystem::Render(const HairInstance* const* instances, size_t count, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const
+    {
+        renderer->Render(instances, count, viewMatrix, projectionMatrix);
+    }
 
-			if (zAxis.Length() < 0.0001f) {
-				zAxis = Vector3::Cross(xAxis, Vector3(0, 1.0f, 0));
-			}
+    //Guides are independent of each other, chunks of them are spread over the pool
+    constexpr uint32_t PrecomputeGrainSize = 512;
 
-			zAxis.Normalize();
-			auto yAxis = Vector3::Cross(zAxis, xAxis);
+    void ParallelRange(ThreadPool* threadPool, uint32_t count, uint32_t grainSize, const ThreadPool::RangeTask& task)
+    {
+        if (threadPool) {
+            threadPool->ParallelFor(count, grainSize, task);
+        }
+        else if (count > 0) {
+            task(0, count);
+        }
+    }
 
-			Matrix3 r;
-			r.m[0][0] = xAxis[0];
-			r.m[0][1] = yAxis[0];
-			r.m[0][2] = zAxis[0];
-			r.m[1][0] = xAxis[1];
-			r.m[1][1] = yAxis[1];
-			r.m[1][2] = zAxis[1];
-			r.m[2][0] = xAxis[2];
-			r.m[2][1] = yAxis[2];
-			r.m[2][2] = zAxis[2];
+    void CalculateConstraints(const StridedPositions& vertices, uint32_t guidesCount, int verticesPerStrand, Vector4* tangentsDistances, ThreadPool* threadPool)
+    {
+        ParallelRange(threadPool, guidesCount, PrecomputeGrainSize, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t guideIndex = begin; guideIndex < end; guideIndex++) {
+                size_t rootVertexIndex = (size_t)guideIndex * verticesPerStrand;
+                for (int i = 0; i < verticesPerStrand - 1; i++) {
+                    auto p0 = vertices[rootVertexIndex + i];
+                    auto p1 = vertices[rootVertexIndex + i + 1];
 
-			globalRotations[rootVertexIndex] = localRotations[rootVertexIndex] = Quaternion::FromMatrix(r);
+                    tangentsDistances[rootVertexIndex + i] = Vector4(0, 0, 0, (p1 - p0).Length());
+                }
 
-			for (int i = 1; i < verticesPerStrand; i++) {
-				auto positionPrev = vertices[rootVertexIndex + i - 1].XYZ();
-				position = vertices[rootVertexIndex + i].XYZ();
-				tangent = position - positionPrev;
-				auto tangentLocal = globalRotations[rootVertexIndex + i - 1].Inversed() * tangent;
-				auto test = globalRotations[rootVertexIndex + i - 1] * tangentLocal;
+                tangentsDistances[rootVertexIndex + verticesPerStrand - 1] = Vector4();
+            }
+        });
+    }
 
-				xAxis = tangentLocal.Normalized();
-				Vector3 x(1.0f, 0, 0);
-				auto rotationAxis = Vector3::Cross(x, xAxis);
-				float angle = acos(Vector3::Dot(x, xAxis));
+    Quaternion CalculateRootRotation(const StridedPositions& vertices, size_t rootVertexIndex)
+    {
+        auto tangent = vertices[rootVertexIndex + 1] - vertices[rootVertexIndex];
+        auto xAxis = tangent.Normalized();
+        auto zAxis = Vector3::Cross(xAxis, Vector3(1.0f, 0, 0));
 
-				if (abs(angle) > 0.001 && rotationAxis.Length2() > 0.001) {
-					rotationAxis.Normalize();
-					localRotations[rootVertexIndex + i] = Quaternion(rotationAxis, angle);
-				}
-				else {
-					localRotations[rootVertexIndex + i] = Quaternion();
-				}
+        if (zAxis.Length() < 0.0001f) {
+            zAxis = Vector3::Cross(xAxis, Vector3(0, 1.0f, 0));
+        }
 
-				globalRotations[rootVertexIndex + i] = globalRotations[rootVertexIndex + i - 1] * localRotations[rootVertexIndex + i];
-				refVectors[rootVertexIndex + i] = Vector4(tangentLocal.x, tangentLocal.y, tangentLocal.z, 0.0f);
-			}
-		}
-	}
+        zAxis.Normalize();
+        auto yAxis = Vector3::Cross(zAxis, xAxis);
+
+        Matrix3 r;
+        r.m[0][0] = xAxis[0];
+        r.m[0][1] = yAxis[0];
+        r.m[0][2] = zAxis[0];
+        r.m[1][0] = xAxis[1];
+        r.m[1][1] = yAxis[1];
+        r.m[1][2] = zAxis[1];
+        r.m[2][0] = xAxis[2];
+        r.m[2][1] = yAxis[2];
+        r.m[2][2] = zAxis[2];
+
+        return Quaternion::FromMatrix(r);
+    }
 
-    HairAsset* HairSystem::LoadAsset(const char* path) const
+    //Frames of Vector4BlockSize strands are transported together, one strand per lane, so the loops
+    //over the lanes vectorize. Lanes past the last guide repeat it and are not written.
+    void CalculateRotationsBlock(const StridedPositions& vertices, uint32_t firstGuide, uint32_t guidesCount, int verticesPerStrand, Quaternion* globalRotations, Vector4* refVectors)
     {
-        auto file = fopen(path, "rb");
-        if (file == nullptr) {
-            throw std::runtime_error(std::string("Cannot open file ") + path);
+        size_t rootVertexIndices[Vector4BlockSize];
+        Quaternion rootRotations[Vector4BlockSize];
+        for (uint32_t lane = 0; lane < Vector4BlockSize; lane++) {
+            rootVertexIndices[lane] = (size_t)(firstGuide + (std::min)(lane, guidesCount - 1)) * verticesPerStrand;
+            rootRotations[lane] = CalculateRootRotation(vertices, rootVertexIndices[lane]);
         }
 
-        fseek(file, 0, SEEK_END);
-        int size = ftell(file);
-        fseek(file, 0, SEEK_SET);
+        Vector4Block rotations;
+        LoadBlock(rootRotations, Vector4BlockSize, rotations);
+        for (uint32_t lane = 0; lane < guidesCount; lane++) {
+            globalRotations[rootVertexIndices[lane]] = rootRotations[lane];
+            refVectors[rootVertexIndices[lane]] = Vector4();
+        }
 
-        int guidesCount = 0;
-        int segmentsCount = 0;
-        int trianglesCount = 0;
+        Vector4Block tangents;
+        Vector4Block localTangents;
+        for (int i = 1; i < verticesPerStrand; i++) {
+            for (uint32_t lane = 0; lane < Vector4BlockSize; lane++) {
+                auto tangent = vertices[rootVertexIndices[lane] + i] - vertices[rootVertexIndices[lane] + i - 1];
+                tangents.x[lane] = tangent.x;
+                tangents.y[lane] = tangent.y;
+                tangents.z[lane] = tangent.z;
+            }
 
-        fread(&guidesCount, sizeof(guidesCount), 1, file);
-        fread(&segmentsCount, sizeof(segmentsCount), 1, file);
-        fread(&trianglesCount, sizeof(trianglesCount), 1, file);
+            for (uint32_t lane = 0; lane < Vector4BlockSize; lane++) {
+                float qx = rotations.x[lane];
+                float qy = rotations.y[lane];
+                float qz = rotations.z[lane];
+                float qw = rotations.w[lane];
+
+                //Tangent in the frame of the previous segment, as Quaternion::Inversed() * tangent
+                float lengthSqr = qx * qx + qy * qy + qz * qz + qw * qw;
+                bool invertible = lengthSqr >= 0.001f;
+                float ix = invertible ? -qx / lengthSqr : 0.0f;
+                float iy = invertible ? -qy / lengthSqr : 0.0f;
+                float iz = invertible ? -qz / lengthSqr : 0.0f;
+                float iw = invertible ? qw / lengthSqr : 1.0f;
+
+                float tx = tangents.x[lane];
+                float ty = tangents.y[lane];
+                float tz = tangents.z[lane];
+                float uvX = iy * tz - iz * ty;
+                float uvY = iz * tx - ix * tz;
+                float uvZ = ix * ty - iy * tx;
+                float uuvX = iy * uvZ - iz * uvY;
+                float uuvY = iz * uvX - ix * uvZ;
+                float uuvZ = ix * uvY - iy * uvX;
+                float lx = tx + uvX * (2.0f * iw) + uuvX * 2.0f;
+                float ly = ty + uvY * (2.0f * iw) + uuvY * 2.0f;
+                float lz = tz + uvZ * (2.0f * iw) + uuvZ * 2.0f;
+                localTangents.x[lane] = lx;
+                localTangents.y[lane] = ly;
+                localTangents.z[lane] = lz;
+
+                //Shortest rotation from the x axis to the local tangent. Its axis is (0, -z, y) and its
+                //cosine x, so the half angle comes from a square root instead of acos, cos and sin.
+                //Bends whose axis is shorter than sqrt(0.001) are not applied, as before.
+                float length = sqrtf(lx * lx + ly * ly + lz * lz);
+                float ax = lx / length;
+                float ay = ly / length;
+                float az = lz / length;
+                bool rotates = az * az + ay * ay > 0.001f;
+                float halfCos = sqrtf((1.0f + ax) * 0.5f);
+                float axisScale = 0.5f / halfCos;
+                float ry = rotates ? -az * axisScale : 0.0f;
+                float rz = rotates ? ay * axisScale : 0.0f;
+                float rw = rotates ? halfCos : 1.0f;
+
+                //rotation * local rotation, rx is zero
+                rotations.w[lane] = qw * rw - qy * ry - qz * rz;
+                rotations.x[lane] = qx * rw + qy * rz - qz * ry;
+                rotations.y[lane] = qw * ry + qy * rw - qx * rz;
+                rotations.z[lane] = qw * rz + qz * rw + qx * ry;
+            }
 
-        int verticesPerStrand = segmentsCount + 1;
-        std::vector<Vector4> vertices(guidesCount * verticesPerStrand);
-        for (int i = 0; i < vertices.size(); i++) {
-            if (feof(file)) {
-                throw std::runtime_error(std::string("Invalid hair asset file ") + path);
+            for (uint32_t lane = 0; lane < guidesCount; lane++) {
+                size_t vertexIndex = rootVertexIndices[lane] + i;
+                globalRotations[vertexIndex] = Quaternion(rotations.x[lane], rotations.y[lane], rotations.z[lane], rotations.w[lane]);
+                refVectors[vertexIndex] = Vector4(localTangents.x[lane], localTangents.y[lane], localTangents.z[lane], 0.0f);
             }
+        }
+    }
 
-            fread(&vertices[i], sizeof(float), 3, file);
-            vertices[i].w = i % verticesPerStrand == 0 ? 0 : 1;
+    void CalculateRotations(const StridedPositions& vertices, uint32_t guidesCount, int verticesPerStrand, Quaternion* globalRotations, Vector4* refVectors, ThreadPool* threadPool)
+    {
+        //Outputs may point to write-only mapped memory, so they are never read back here
+        uint32_t blocksCount = (guidesCount + Vector4BlockSize - 1) / Vector4BlockSize;
+        ParallelRange(threadPool, blocksCount, PrecomputeGrainSize / Vector4BlockSize, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t block = begin; block < end; block++) {
+                uint32_t firstGuide = block * Vector4BlockSize;
+                uint32_t blockGuidesCount = (std::min)(guidesCount - firstGuide, (uint32_t)Vector4BlockSize);
+                CalculateRotationsBlock(vertices, firstGuide, blockGuidesCount, verticesPerStrand, globalRotations, refVectors);
+            }
+        });
+    }
+
+    void CalculateReachBounds(const StridedPositions& vertices, uint32_t guidesCount, int verticesPerStrand, Vector3& boundsMin, Vector3& boundsMax)
+    {
+        boundsMin = Vector3();
+        boundsMax = Vector3();
+        for (uint32_t guide = 0; guide < guidesCount; guide++) {
+            size_t rootVertexIndex = (size_t)guide * verticesPerStrand;
+            auto root = vertices[rootVertexIndex];
+            float length = 0.0f;
+            for (int i = 1; i < verticesPerStrand; i++) {
+                length += (vertices[rootVertexIndex + i] - vertices[rootVertexIndex + i - 1]).Length();
+            }
+
+            for (int k = 0; k < 3; k++) {
+                boundsMin.m[k] = guide == 0 ? root.m[k] - length : (std::min)(boundsMin.m[k], root.m[k] - length);
+                boundsMax.m[k] = guide == 0 ? root.m[k] + length : (std::max)(boundsMax.m[k], root.m[k] + length);
+            }
         }
+    }
 
-        std::vector<int> triangles(trianglesCount * 4, 0);
-        for (int i = 0; i < trianglesCount; i++) {
-            if (feof(file)) {
-                throw std::runtime_error(std::string("Invalid hair asset file ") + path);
+    void FreeAsset(const HairAsset* asset)
+    {
+        glDeleteBuffers(1, &asset->restPositionsBufferID);
+        glDeleteBuffers(1, &asset->tangentsDistancesBufferID);
+        glDeleteBuffers(1, &asset->hairIndicesBufferID);
+        glDeleteBuffers(1, &asset->refVectorsBufferID);
+        glDeleteBuffers(1, &asset->globalRotationsBufferID);
+        glDeleteBuffers(1, &asset->debugBufferID);
+        glDeleteBuffers(2, asset->instancePool.positionsBufferIDs);
+        glDeleteBuffers(1, &asset->instancePool.simulationParamsBufferID);
+        delete asset->cpuData;
+        delete asset;
+    }
+
+    //Frees an asset that failed while being created, buffers it left mapped are unmapped first
+    struct PendingAssetDeleter
+    {
+        void operator()(HairAsset* asset) const
+        {
+            const GLenum targets[][2] = {
+                { GL_SHADER_STORAGE_BUFFER, GL_SHADER_STORAGE_BUFFER_BINDING },
+                { GL_COPY_WRITE_BUFFER, GL_COPY_WRITE_BUFFER_BINDING },
+                { GL_COPY_READ_BUFFER, GL_COPY_READ_BUFFER_BINDING }
+            };
+
+            for (auto& target : targets) {
+                GLint bufferID = 0;
+                GLint mapped = GL_FALSE;
+                glGetIntegerv(target[1], &bufferID);
+                if (bufferID != 0) {
+                    glGetBufferParameteriv(target[0], GL_BUFFER_MAPPED, &mapped);
+                }
+                if (mapped) {
+                    glUnmapBuffer(target[0]);
+                }
+                glBindBuffer(target[0], 0);
             }
 
-            fread(&triangles[i * 4], sizeof(int), 3, file);
+            FreeAsset(asset);
         }
+    };
 
-        fclose(file);
+    //Owns an asset until it is handed to the cache
+    typedef std::unique_ptr<HairAsset, PendingAssetDeleter> PendingAsset;
 
-        std::vector<Vector4> tangetsDistances;
-        CalculateConstraints(vertices, verticesPerStrand, tangetsDistances);
+    template <typename T>
+    T* CreateMappedBuffer(GLenum target, size_t elementsCount, uint32_t& bufferID)
+    {
+        size_t size = elementsCount * sizeof(T);
+
+        glGenBuffers(1, &bufferID);
+        glBindBuffer(target, bufferID);
+        glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+
+        if (size == 0) {
+            return nullptr;
+        }
 
-		std::vector<Vector4> refVectors;
-		std::vector<Quaternion> globalRotations;
-		CalculateRotations(vertices, verticesPerStrand, globalRotations, refVectors);
+        auto data = static_cast<T*>(glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (data == nullptr) {
+            throw std::runtime_error("Cannot map hair asset buffer.");
+        }
+
+        return data;
+    }
+
+    void UnmapBuffer(GLenum target, const void* data)
+    {
+        if (data != nullptr && glUnmapBuffer(target) == GL_FALSE) {
+            throw std::runtime_error("Hair asset buffer contents were lost during upload.");
+        }
+        glBindBuffer(target, 0);
+    }
+
+    template <typename T>
+    uint32_t CreateStaticBuffer(const std::vector<T>& elements)
+    {
+        uint32_t bufferID;
+        glGenBuffers(1, &bufferID);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferID);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, elements.size() * sizeof(T), elements.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return bufferID;
+    }
+
+    //Compact data is packed on the host first, it can't be copied straight from the file
+    PendingAsset CreateCompactAsset(const HairAssetFileView& view, ThreadPool* threadPool)
+    {
+        HairAssetData data;
+        HairAssetCompactData compactData;
+        ReadHairAssetData(view, data, threadPool);
+        PackHairAssetData(data, compactData);
+
+        PendingAsset asset(new HairAsset());
+        asset->guidesCount = view.guidesCount;
+        asset->segmentsCount = view.segmentsCount;
+        asset->trianglesCount = view.trianglesCount;
+        asset->instancePool = {};
+        asset->compact = true;
+        asset->restBoundsMin = compactData.boundsMin;
+        asset->restBoundsSize = compactData.boundsSize;
+        asset->reachBoundsMin = data.reachBoundsMin;
+        asset->reachBoundsMax = data.reachBoundsMax;
+
+        asset->restPositionsBufferID = CreateStaticBuffer(compactData.restPositions);
+        asset->hairIndicesBufferID = CreateStaticBuffer(data.triangles);
+        asset->tangentsDistancesBufferID = CreateStaticBuffer(compactData.tangentsDistances);
+        asset->refVectorsBufferID = CreateStaticBuffer(compactData.refVectors);
+        asset->globalRotationsBufferID = CreateStaticBuffer(compactData.globalRotations);
+        asset->debugBufferID = CreateStaticBuffer(std::vector<Vector4>(data.positions.size()));
+        asset->cpuData = CreateCompactCPUData(data);
+
+        return asset;
+    }
+
+    HairAsset* HairSystem::LoadAsset(const char* path) const
+    {
+        auto cacheKey = AssetCache::GetKey(path);
+        auto cachedAsset = assetCache->Acquire(cacheKey);
+        if (cachedAsset) {
+            return cachedAsset;
+        }
 
-        auto asset = new HairAsset();
-        asset->guidesCount = guidesCount;
-        asset->segmentsCount = segmentsCount;
-        asset->trianglesCount = trianglesCount;
+        //Every section is copied once, from the file mapping straight into mapped buffer storage
+        MappedFile file(path);
+        HairAssetFileView view;
+        ParseHairAssetFile(file.GetData(), file.GetSize(), path, view);
 
-        glGenBuffers(1, &asset->restPositionsBufferID);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, asset->restPositionsBufferID);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(Vector4), vertices.data(), GL_STATIC_DRAW);
+        size_t verticesCount = view.GetVerticesCount();
+        int verticesPerStrand = view.segmentsCount + 1;
 
-        glGenBuffers(1, &asset->hairIndicesBufferID);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, asset->hairIndicesBufferID);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, triangles.size() * sizeof(int), triangles.data(), GL_STATIC_DRAW);
+        if ((uint32_t)verticesPerStrand > settings.maxStrandVertices) {
+            throw std::runtime_error(std::string("Strands exceed maxStrandVertices in hair asset file ") + path);
+        }
 
-        glGenBuffers(1, &asset->tangentsDistancesBufferID);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, asset->tangentsDistancesBufferID);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, tangetsDistances.size() * sizeof(Vector4), tangetsDistances.data(), GL_STATIC_DRAW);
+        if (settings.compactStorage) {
+            return assetCache->Add(cacheKey, CreateCompactAsset(view, threadPool).release());
+        }
 
-		glGenBuffers(1, &asset->refVectorsBufferID);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, asset->refVectorsBufferID);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, refVectors.size() * sizeof(Vector4), refVectors.data(), GL_STATIC_DRAW);
+        PendingAsset asset(new HairAsset());
+        asset->guidesCount = view.guidesCount;
+        asset->segmentsCount = view.segmentsCount;
+        asset->trianglesCount = view.trianglesCount;
+        asset->cpuData = nullptr;
+        asset->instancePool = {};
+        CalculateReachBounds(view.GetPositions(), view.guidesCount, verticesPerStrand, asset->reachBoundsMin, asset->reachBoundsMax);
+
+        auto positions = CreateMappedBuffer<Vector4>(GL_SHADER_STORAGE_BUFFER, verticesCount, asset->restPositionsBufferID);
+        CopyPositions(view, positions);
+        UnmapBuffer(GL_SHADER_STORAGE_BUFFER, positions);
+
+        auto triangles = CreateMappedBuffer<int32_t>(GL_SHADER_STORAGE_BUFFER, view.trianglesCount * 4, asset->hairIndicesBufferID);
+        CopyTriangles(view, triangles);
+        UnmapBuffer(GL_SHADER_STORAGE_BUFFER, triangles);
+
+        auto tangentsDistances = CreateMappedBuffer<Vector4>(GL_SHADER_STORAGE_BUFFER, verticesCount, asset->tangentsDistancesBufferID);
+        auto refVectors = CreateMappedBuffer<Vector4>(GL_COPY_WRITE_BUFFER, verticesCount, asset->refVectorsBufferID);
+        auto globalRotations = CreateMappedBuffer<Quaternion>(GL_COPY_READ_BUFFER, verticesCount, asset->globalRotationsBufferID);
+
+        if (verticesCount > 0) {
+            if (view.HasConstraints()) {
+                memcpy(tangentsDistances, view.tangentsDistances, verticesCount * sizeof(Vector4));
+                memcpy(refVectors, view.refVectors, verticesCount * sizeof(Vector4));
+                memcpy(globalRotations, view.globalRotations, verticesCount * sizeof(Quaternion));
+            }
+            else {
+                CalculateConstraints(view.GetPositions(), view.guidesCount, verticesPerStrand, tangentsDistances, threadPool);
+                CalculateRotations(view.GetPositions(), view.guidesCount, verticesPerStrand, globalRotations, refVectors, threadPool);
+            }
+        }
 
-		glGenBuffers(1, &asset->globalRotationsBufferID);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, asset->globalRotationsBufferID);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, globalRotations.size() * sizeof(Quaternion), globalRotations.data(), GL_STATIC_DRAW);
+        UnmapBuffer(GL_SHADER_STORAGE_BUFFER, tangentsDistances);
+        UnmapBuffer(GL_COPY_WRITE_BUFFER, refVectors);
+        UnmapBuffer(GL_COPY_READ_BUFFER, globalRotations);
 
 		glGenBuffers(1, &asset->debugBufferID);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, asset->debugBufferID);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(Vector4), nullptr, GL_STATIC_DRAW);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, verticesCount * sizeof(Vector4), nullptr, GL_STATIC_DRAW);
 
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-        return asset;
+        return assetCache->Add(cacheKey, asset.release());
+    }
+
+    HairAssetLoad* HairSystem::LoadAssetAsync(const char* path) const
+    {
+        auto cacheKey = AssetCache::GetKey(path);
+        auto cachedAsset = assetCache->Acquire(cacheKey);
+        if (cachedAsset) {
+            return assetLoader->AddLoaded(cachedAsset);
+        }
+
+        return assetLoader->Load(path, cacheKey);
+    }
+
+    HairAssetLoadState HairSystem::GetAssetLoadState(const HairAssetLoad* load) const
+    {
+        return load->source ? load->source->state : load->state;
+    }
+
+    HairAsset* HairSystem::FinishAssetLoad(HairAssetLoad* load) const
+    {
+        //Finishing any load of a file caches the asset once, its own load keeps the reference the
+        //cache hands out and every load waiting for it takes one more
+        auto source = load->source ? load->source : load;
+        if (!source->cached) {
+            assetLoader->Complete(source);
+            if (source->state == HairAssetLoadState::Ready) {
+                auto cachedAsset = assetCache->Add(source->cacheKey, source->asset);
+                if (cachedAsset != source->asset) {
+                    FreeAsset(source->asset);
+                    source->asset = cachedAsset;
+                }
+                source->cached = true;
+            }
+
+            for (auto waitingLoad : assetLoader->DetachWaitingLoads(source)) {
+                waitingLoad->error = source->error;
+                waitingLoad->state = source->state.load();
+                if (source->cached) {
+                    waitingLoad->asset = source->asset;
+                    waitingLoad->cached = true;
+                    assetCache->AddReference(source->asset);
+                }
+            }
+        }
+
+        return assetLoader->Finish(load);
+    }
+
+    template <typename T>
+    void ReadAssetBuffer(uint32_t bufferID, size_t elementsCount, std::vector<T>& elements)
+    {
+        elements.resize(elementsCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, bufferID);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, elementsCount * sizeof(T), elements.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    void HairSystem::SaveAsset(const HairAsset* asset, const char* path) const
+    {
+        size_t verticesCount = asset->guidesCount * (asset->segmentsCount + 1);
+
+        HairAssetData data;
+        data.guidesCount = asset->guidesCount;
+        data.segmentsCount = asset->segmentsCount;
+        data.trianglesCount = asset->trianglesCount;
+        ReadAssetBuffer(asset->hairIndicesBufferID, asset->trianglesCount * 4, data.triangles);
+
+        //Compact assets are saved with the precision they were simulated with
+        if (asset->compact) {
+            data.positions = asset->cpuData->restPositions;
+            data.tangentsDistances = asset->cpuData->tangentsDistances;
+            data.refVectors = asset->cpuData->refVectors;
+            data.globalRotations = asset->cpuData->globalRotations;
+        }
+        else {
+            ReadAssetBuffer(asset->restPositionsBufferID, verticesCount, data.positions);
+            ReadAssetBuffer(asset->tangentsDistancesBufferID, verticesCount, data.tangentsDistances);
+            ReadAssetBuffer(asset->refVectorsBufferID, verticesCount, data.refVectors);
+            ReadAssetBuffer(asset->globalRotationsBufferID, verticesCount, data.globalRotations);
+        }
+
+        WriteHairAssetFile(path, data);
     }
 
     void HairSystem::DestroyAsset(HairAsset* asset) const
     {
-        glDeleteBuffers(1, &asset->restPositionsBufferID);
-        delete asset;
+        //Instances of the asset keep it alive, it is freed with the last of them
+        if (assetCache->Release(asset)) {
+            FreeAsset(asset);
+        }
     }
 
-    void CopyBuffer(uint32_t src, uint32_t dst, int size)
+    void CopyBuffer(uint32_t src, uint32_t dst, size_t size, size_t dstOffset = 0)
     {
         glBindBuffer(GL_COPY_READ_BUFFER, src);
         glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, dstOffset, size);
     }
 
-    HairInstance* HairSystem::CreateInstance(const HairAsset* asset) const
+    uint32_t GrowPoolBuffer(uint32_t bufferID, size_t oldSize, size_t newSize)
     {
-        auto instance = new HairInstance();
-        instance->asset = asset;
+        uint32_t newBufferID;
+        glGenBuffers(1, &newBufferID);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, newBufferID);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, newSize, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-        size_t positionsSize = sizeof(Vector4) * asset->guidesCount * (asset->segmentsCount + 1);
+        if (bufferID != 0) {
+            CopyBuffer(bufferID, newBufferID, oldSize);
+            glDeleteBuffers(1, &bufferID);
+        }
 
-        glGenBuffers(1, &instance->positionsBufferID);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance->positionsBufferID);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, positionsSize, nullptr, GL_DYNAMIC_DRAW);
+        return newBufferID;
+    }
 
-        glGenBuffers(1, &instance->previousPositionsBufferID);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance->previousPositionsBufferID);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, positionsSize, nullptr, GL_DYNAMIC_DRAW);
+    uint32_t AllocatePoolSlot(const HairAsset* asset, HairInstance* instance)
+    {
+        auto& pool = asset->instancePool;
+
+        if (pool.slotVerticesCount == 0) {
+            //Slots start at offsets that can be bound as a shader storage range
+            int offsetAlignment = 0;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+            uint32_t alignmentVertices = (std::max)(1u, (uint32_t)offsetAlignment / (uint32_t)sizeof(Vector4));
+            uint32_t verticesCount = (std::max)(1u, asset->guidesCount * (asset->segmentsCount + 1));
+            pool.slotVerticesCount = (verticesCount + alignmentVertices - 1) / alignmentVertices * alignmentVertices;
+        }
 
-        CopyBuffer(asset->restPositionsBufferID, instance->positionsBufferID, positionsSize);
-        CopyBuffer(asset->restPositionsBufferID, instance->previousPositionsBufferID, positionsSize);
+        for (uint32_t slot = 0; slot < pool.slots.size(); slot++) {
+            if (pool.slots[slot] == nullptr) {
+                pool.slots[slot] = instance;
+                return slot;
+            }
+        }
+
+        if (pool.slots.size() == pool.capacity) {
+            uint32_t capacity = (std::max)(4u, pool.capacity * 2);
+            size_t slotSize = (size_t)pool.slotVerticesCount * sizeof(Vector4);
+            for (auto& bufferID : pool.positionsBufferIDs) {
+                bufferID = GrowPoolBuffer(bufferID, pool.capacity * slotSize, capacity * slotSize);
+            }
+            pool.capacity = capacity;
+        }
+
+        pool.slots.push_back(instance);
+        return pool.slots.size() - 1;
+    }
+
+    HairInstance* HairSystem::CreateInstance(const HairAsset* asset) const
+    {
+        auto instance = new HairInstance();
+        instance->asset = asset;
+        instance->cpuPositionsValid = false;
+        instance->simulationParamsDirty = true;
+        instance->timeAccumulator = 0.0f;
+        instance->interpolationFactor = 1.0f;
+        instance->poolSlot = AllocatePoolSlot(asset, instance);
+        instance->positionsBuffer = 0;
+        assetCache->AddReference(asset);
+
+        size_t positionsSize = GetPositionsSize(instance);
+        size_t positionsOffset = GetPositionsOffset(instance);
+        if (asset->compact) {
+            auto& restPositions = asset->cpuData->restPositions;
+            for (auto bufferID : asset->instancePool.positionsBufferIDs) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+                glBufferSubData(GL_COPY_WRITE_BUFFER, positionsOffset, positionsSize, restPositions.data());
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        else {
+            for (auto bufferID : asset->instancePool.positionsBufferIDs) {
+                CopyBuffer(asset->restPositionsBufferID, bufferID, positionsSize, positionsOffset);
+            }
+        }
 
         return instance;
     }
 
     void HairSystem::UpdateInstanceSettings(HairInstance* instance, const HairInstanceSettings& settings) const
     {
+        if (!HasSameSimulationSettings(instance->settings, settings)) {
+            instance->simulationParamsDirty = true;
+        }
         instance->settings = settings;
     }
 
+    void HairSystem::UpdateInstanceColliders(HairInstance* instance, const HairCollider* colliders, size_t count) const
+    {
+        instance->colliders.assign(colliders, colliders + count);
+    }
+
     void HairSystem::DestroyInstance(HairInstance* instance) const
     {
-        glDeleteBuffers(1, &instance->positionsBufferID);
+        auto asset = instance->asset;
+        asset->instancePool.slots[instance->poolSlot] = nullptr;
         delete instance;
+
+        if (assetCache->Release(asset)) {
+            FreeAsset(asset);
+        }
+    }
+
+    void HairSystem::SetFrameStatsEnabled(bool enabled) const
+    {
+        profiler->SetEnabled(enabled);
+    }
+
+    void HairSystem::EndFrame() const
+    {
+        assetLoader->Upload();
+        profiler->EndFrame();
+    }
+
+    const HairFrameStats& HairSystem::GetFrameStats() const
+    {
+        return profiler->GetLatestStats();
     }
 
     HairSystem::~HairSystem()
     {
+        delete assetLoader;
+        delete assetCache;
+        delete cpuSimulator;
+        delete threadPool;
         delete renderer;
+        delete profiler;
     }
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace HairGL
+{
+#ifdef _WIN32
+    MappedFile::MappedFile(const char* path) :
+        data(nullptr),
+        size(0),
+        fileHandle(INVALID_HANDLE_VALUE),
+        mappingHandle(nullptr)
+    {
+        fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error(std::string("Cannot open file ") + path);
+        }
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(fileHandle, &fileSize);
+        size = (size_t)fileSize.QuadPart;
+
+        if (size > 0) {
+            mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mappingHandle ? static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if (data == nullptr) {
+                if (mappingHandle) {
+                    CloseHandle(mappingHandle);
+                }
+                CloseHandle(fileHandle);
+                throw std::runtime_error(std::string("Cannot map file ") + path);
+            }
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data) {
+            UnmapViewOfFile(data);
+            CloseHandle(mappingHandle);
+        }
+        CloseHandle(fileHandle);
+    }
+#else
+    MappedFile::MappedFile(const char* path) :
+        data(nullptr),
+        size(0),
+        fileDescriptor(-1)
+    {
+        fileDescriptor = open(path, O_RDONLY);
+        if (fileDescriptor < 0) {
+            throw std::runtime_error(std::string("Cannot open file ") + path);
+        }
+
+        struct stat fileStat;
+        fstat(fileDescriptor, &fileStat);
+        size = (size_t)fileStat.st_size;
+
+        if (size > 0) {
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+            if (mapping == MAP_FAILED) {
+                close(fileDescriptor);
+                throw std::runtime_error(std::string("Cannot map file ") + path);
+            }
+
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const uint8_t*>(mapping);
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+        close(fileDescriptor);
+    }
+#endif
+
+    const uint8_t* MappedFile::GetData() const
+    {
+        return data;
+    }
+
+    size_t MappedFile::GetSize() const
+    {
+        return size;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef HAIRGL_MAPPED_FILE_H
+#define HAIRGL_MAPPED_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace HairGL
+{
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const char* path);
+        MappedFile(const MappedFile&) = delete;
+        const uint8_t* GetData() const;
+        size_t GetSize() const;
+        ~MappedFile();
+
+    private:
+        const uint8_t* data;
+        size_t size;
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#else
+        int fileDescriptor;
+#endif
+    };
+}
+
+#endif
@@ -1,6 +1,23 @@
 #include <hairgl/HairGL.h>
+#include <algorithm>
 #include <math.h>
 #include <memory>
+#include <string.h>
+
+//Single values go through intrinsics where the target has them, batches through the block
+//functions at the end. Every path does the same operations in the same order as the scalar one,
+//so they round alike unless the compiler fuses multiplies and adds for an FMA target.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HAIRGL_MATH_SSE
+#include <xmmintrin.h>
+#ifdef __AVX__
+#define HAIRGL_MATH_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define HAIRGL_MATH_NEON
+#include <arm_neon.h>
+#endif
 
 namespace HairGL
 {
@@ -72,17 +89,30 @@ namespace HairGL
 
     Vector4 Vector4::Normalized() const
     {
+#if defined(HAIRGL_MATH_SSE)
+        //Squares are summed lane by lane, in the order of Length
+        Vector4 r;
+        __m128 v = _mm_loadu_ps(m);
+        __m128 squares = _mm_mul_ps(v, v);
+        __m128 sum = _mm_add_ss(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(1, 1, 1, 1)));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 2, 2, 2)));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 3, 3, 3)));
+        __m128 length = _mm_sqrt_ss(sum);
+        _mm_storeu_ps(r.m, _mm_div_ps(v, _mm_shuffle_ps(length, length, 0)));
+        return r;
+#elif defined(HAIRGL_MATH_NEON)
+        Vector4 r;
+        vst1q_f32(r.m, vdivq_f32(vld1q_f32(m), vdupq_n_f32(Length())));
+        return r;
+#else
         float l = Length();
         return Vector4(x / l, y / l, z / l, w / l);
+#endif
     }
 
     Vector4& Vector4::Normalize()
     {
-        float l = Length();
-        x /= l;
-        y /= l;
-        z /= l;
-        w /= l;
+        *this = Normalized();
         return *this;
     }
 
@@ -300,29 +330,100 @@ namespace HairGL
         return rInv * tInv;
     }
 
+#if defined(HAIRGL_MATH_SSE)
+    //Column of this matrix times the four components of v, summed left to right
+    inline __m128 TransformColumn(const Vector4* columns, const Vector4& v)
+    {
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(columns[0].m), _mm_set1_ps(v.x));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(columns[1].m), _mm_set1_ps(v.y)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(columns[2].m), _mm_set1_ps(v.z)));
+        return _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(columns[3].m), _mm_set1_ps(v.w)));
+    }
+#elif defined(HAIRGL_MATH_NEON)
+    inline float32x4_t TransformColumn(const Vector4* columns, const Vector4& v)
+    {
+        float32x4_t r = vmulq_n_f32(vld1q_f32(columns[0].m), v.x);
+        r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(columns[1].m), v.y));
+        r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(columns[2].m), v.z));
+        return vaddq_f32(r, vmulq_n_f32(vld1q_f32(columns[3].m), v.w));
+    }
+#endif
+
+    //Columns of the result are combinations of the columns of this matrix
     Matrix4 Matrix4::operator*(const Matrix4& other) const
     {
         Matrix4 r;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                float sum = 0.0f;
-                for (int k = 0; k < 4; k++) {
-                    sum += m[k][i] * other.m[j][k];
-                }
-                r.m[j][i] = sum;
+#if defined(HAIRGL_MATH_AVX)
+        //Two columns of the result at once, every column of this matrix fills both halves
+        for (int j = 0; j < 4; j += 2) {
+            __m256 sum = _mm256_setzero_ps();
+            for (int k = 0; k < 4; k++) {
+                __m256 column = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m[k].m));
+                __m256 factors = _mm256_insertf128_ps(_mm256_set1_ps(other.m[j][k]), _mm_set1_ps(other.m[j + 1][k]), 1);
+                __m256 product = _mm256_mul_ps(column, factors);
+                sum = k == 0 ? product : _mm256_add_ps(sum, product);
+            }
+            _mm256_storeu_ps(r.m[j].m, sum);
+        }
+#elif defined(HAIRGL_MATH_SSE)
+        for (int j = 0; j < 4; j++) {
+            _mm_storeu_ps(r.m[j].m, TransformColumn(m, other.m[j]));
+        }
+#elif defined(HAIRGL_MATH_NEON)
+        for (int j = 0; j < 4; j++) {
+            vst1q_f32(r.m[j].m, TransformColumn(m, other.m[j]));
+        }
+#else
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                r.m[j][i] = m[0][i] * other.m[j][0] + m[1][i] * other.m[j][1] + m[2][i] * other.m[j][2] + m[3][i] * other.m[j][3];
             }
         }
+#endif
+        return r;
+    }
+
+    Vector4 Matrix4::Transform(const Vector4& v) const
+    {
+        Vector4 r;
+#if defined(HAIRGL_MATH_SSE)
+        _mm_storeu_ps(r.m, TransformColumn(m, v));
+#elif defined(HAIRGL_MATH_NEON)
+        vst1q_f32(r.m, TransformColumn(m, v));
+#else
+        for (int i = 0; i < 4; i++) {
+            r.m[i] = m[0][i] * v.x + m[1][i] * v.y + m[2][i] * v.z + m[3][i] * v.w;
+        }
+#endif
         return r;
     }
 
     Vector4 Matrix4::operator*(const Vector4& v) const
     {
-        return Vector4(
-            m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2] + m[0][3] * v[3],
-            m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2] + m[1][3] * v[3],
-            m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2] + m[2][3] * v[3],
-            m[3][0] * v[0] + m[3][1] * v[1] + m[3][2] * v[2] + m[3][3] * v[3]
-        );
+        Vector4 r;
+#if defined(HAIRGL_MATH_SSE)
+        //Transposed, so the dot products of the rows are summed lane by lane in the same order
+        __m128 c0 = _mm_loadu_ps(m[0].m);
+        __m128 c1 = _mm_loadu_ps(m[1].m);
+        __m128 c2 = _mm_loadu_ps(m[2].m);
+        __m128 c3 = _mm_loadu_ps(m[3].m);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        __m128 sum = _mm_mul_ps(c0, _mm_set1_ps(v.x));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(v.y)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(v.z)));
+        _mm_storeu_ps(r.m, _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(v.w))));
+#elif defined(HAIRGL_MATH_NEON)
+        float32x4x4_t c = vld4q_f32(m[0].m);
+        float32x4_t sum = vmulq_n_f32(c.val[0], v.x);
+        sum = vaddq_f32(sum, vmulq_n_f32(c.val[1], v.y));
+        sum = vaddq_f32(sum, vmulq_n_f32(c.val[2], v.z));
+        vst1q_f32(r.m, vaddq_f32(sum, vmulq_n_f32(c.val[3], v.w)));
+#else
+        for (int i = 0; i < 4; i++) {
+            r.m[i] = m[i][0] * v.x + m[i][1] * v.y + m[i][2] * v.z + m[i][3] * v.w;
+        }
+#endif
+        return r;
     }
 
 	void Matrix3::SetIdentity()
@@ -416,8 +517,48 @@ namespace HairGL
 		return result;
 	}
 
+#if defined(HAIRGL_MATH_SSE)
+	//Lanes are x, y, z and one unused
+	inline __m128 Cross(__m128 a, __m128 b)
+	{
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 aZXY = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bZXY = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+		return _mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX));
+	}
+#endif
+
 	Vector3 Quaternion::operator*(const Vector3& v) const
 	{
+#if defined(HAIRGL_MATH_SSE)
+		__m128 qvec = _mm_setr_ps(x, y, z, 0.0f);
+		__m128 vec = _mm_setr_ps(v.x, v.y, v.z, 0.0f);
+		__m128 uv = Cross(qvec, vec);
+		__m128 uuv = Cross(qvec, uv);
+		uv = _mm_mul_ps(uv, _mm_set1_ps(2.0f * w));
+		uuv = _mm_mul_ps(uuv, _mm_set1_ps(2.0f));
+
+		float r[4];
+		_mm_storeu_ps(r, _mm_add_ps(_mm_add_ps(vec, uv), uuv));
+		return Vector3(r[0], r[1], r[2]);
+#elif defined(HAIRGL_MATH_NEON)
+		float32x4_t vec = { v.x, v.y, v.z, 0.0f };
+		float32x4_t qvecYZX = { y, z, x, 0.0f };
+		float32x4_t qvecZXY = { z, x, y, 0.0f };
+		float32x4_t vecYZX = { v.y, v.z, v.x, 0.0f };
+		float32x4_t vecZXY = { v.z, v.x, v.y, 0.0f };
+		float32x4_t uv = vsubq_f32(vmulq_f32(qvecYZX, vecZXY), vmulq_f32(qvecZXY, vecYZX));
+		float32x4_t uvYZX = { vgetq_lane_f32(uv, 1), vgetq_lane_f32(uv, 2), vgetq_lane_f32(uv, 0), 0.0f };
+		float32x4_t uvZXY = { vgetq_lane_f32(uv, 2), vgetq_lane_f32(uv, 0), vgetq_lane_f32(uv, 1), 0.0f };
+		float32x4_t uuv = vsubq_f32(vmulq_f32(qvecYZX, uvZXY), vmulq_f32(qvecZXY, uvYZX));
+		uv = vmulq_n_f32(uv, 2.0f * w);
+		uuv = vmulq_n_f32(uuv, 2.0f);
+
+		float r[4];
+		vst1q_f32(r, vaddq_f32(vaddq_f32(vec, uv), uuv));
+		return Vector3(r[0], r[1], r[2]);
+#else
 		auto qvec = Vector3(x, y, z);
 		auto uv = Vector3::Cross(qvec, v);
 		auto uuv = Vector3::Cross(qvec, uv);
@@ -425,17 +566,187 @@ namespace HairGL
 		uuv *= 2.0f;
 
 		return v + uv + uuv;
+#endif
 	}
 
 	Quaternion Quaternion::operator*(const Quaternion& other) const
 	{
 		Quaternion q;
-
+#if defined(HAIRGL_MATH_SSE)
+		//w * other + (x y z x) * (ow ow ow ox) + (y z x y) * (oz ox oy oy) - (z x y z) * (oy oz ox oz),
+		//with the products of the last lane of the middle terms negated
+		__m128 a = _mm_loadu_ps(m);
+		__m128 b = _mm_loadu_ps(other.m);
+		__m128 negateW = _mm_setr_ps(0.0f, 0.0f, 0.0f, -0.0f);
+		__m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+		__m128 term = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 2, 1, 0)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 3, 3)));
+		r = _mm_add_ps(r, _mm_xor_ps(term, negateW));
+		term = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 2, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 0, 2)));
+		r = _mm_add_ps(r, _mm_xor_ps(term, negateW));
+		term = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 1, 0, 2)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 0, 2, 1)));
+		_mm_storeu_ps(q.m, _mm_sub_ps(r, term));
+#elif defined(HAIRGL_MATH_NEON)
+		float32x4_t negateW = { 1.0f, 1.0f, 1.0f, -1.0f };
+		float32x4_t a0 = { x, y, z, x };
+		float32x4_t b0 = { other.w, other.w, other.w, other.x };
+		float32x4_t a1 = { y, z, x, y };
+		float32x4_t b1 = { other.z, other.x, other.y, other.y };
+		float32x4_t a2 = { z, x, y, z };
+		float32x4_t b2 = { other.y, other.z, other.x, other.z };
+		float32x4_t r = vmulq_n_f32(vld1q_f32(other.m), w);
+		r = vaddq_f32(r, vmulq_f32(vmulq_f32(a0, b0), negateW));
+		r = vaddq_f32(r, vmulq_f32(vmulq_f32(a1, b1), negateW));
+		vst1q_f32(q.m, vsubq_f32(r, vmulq_f32(a2, b2)));
+#else
 		q.w = w * other.w - x * other.x - y * other.y - z * other.z;
 		q.x = w * other.x + x * other.w + y * other.z - z * other.y;
 		q.y = w * other.y + y * other.w + z * other.x - x * other.z;
 		q.z = w * other.z + z * other.w + x * other.y - y * other.x;
-
+#endif
 		return q;
 	}
-}
\ No newline at end of file
+
+    void LoadBlock(const Vector4* vectors, size_t count, Vector4Block& block)
+    {
+        for (size_t lane = 0; lane < Vector4BlockSize; lane++) {
+            bool loaded = lane < count;
+            block.x[lane] = loaded ? vectors[lane].x : 0.0f;
+            block.y[lane] = loaded ? vectors[lane].y : 0.0f;
+            block.z[lane] = loaded ? vectors[lane].z : 0.0f;
+            block.w[lane] = loaded ? vectors[lane].w : 0.0f;
+        }
+    }
+
+    void StoreBlock(const Vector4Block& block, size_t count, Vector4* vectors)
+    {
+        for (size_t lane = 0; lane < count; lane++) {
+            vectors[lane] = Vector4(block.x[lane], block.y[lane], block.z[lane], block.w[lane]);
+        }
+    }
+
+    void LoadBlock(const Quaternion* quaternions, size_t count, Vector4Block& block)
+    {
+        for (size_t lane = 0; lane < Vector4BlockSize; lane++) {
+            bool loaded = lane < count;
+            block.x[lane] = loaded ? quaternions[lane].x : 0.0f;
+            block.y[lane] = loaded ? quaternions[lane].y : 0.0f;
+            block.z[lane] = loaded ? quaternions[lane].z : 0.0f;
+            block.w[lane] = loaded ? quaternions[lane].w : 0.0f;
+        }
+    }
+
+    void StoreBlock(const Vector4Block& block, size_t count, Quaternion* quaternions)
+    {
+        for (size_t lane = 0; lane < count; lane++) {
+            quaternions[lane] = Quaternion(block.x[lane], block.y[lane], block.z[lane], block.w[lane]);
+        }
+    }
+
+    void TransformBlocks(const Matrix4& matrix, const Vector4Block* input, Vector4Block* output, size_t blocksCount)
+    {
+        auto& m = matrix.m;
+        for (size_t b = 0; b < blocksCount; b++) {
+            auto& v = input[b];
+            Vector4Block r;
+            for (size_t lane = 0; lane < Vector4BlockSize; lane++) {
+                r.x[lane] = m[0].x * v.x[lane] + m[1].x * v.y[lane] + m[2].x * v.z[lane] + m[3].x * v.w[lane];
+                r.y[lane] = m[0].y * v.x[lane] + m[1].y * v.y[lane] + m[2].y * v.z[lane] + m[3].y * v.w[lane];
+                r.z[lane] = m[0].z * v.x[lane] + m[1].z * v.y[lane] + m[2].z * v.z[lane] + m[3].z * v.w[lane];
+                r.w[lane] = m[0].w * v.x[lane] + m[1].w * v.y[lane] + m[2].w * v.z[lane] + m[3].w * v.w[lane];
+            }
+            output[b] = r;
+        }
+    }
+
+    void RotateBlocks(const Quaternion& rotation, const Vector4Block* input, Vector4Block* output, size_t blocksCount)
+    {
+        float qx = rotation.x;
+        float qy = rotation.y;
+        float qz = rotation.z;
+        float qw2 = 2.0f * rotation.w;
+
+        for (size_t b = 0; b < blocksCount; b++) {
+            auto& v = input[b];
+            Vector4Block r;
+            for (size_t lane = 0; lane < Vector4BlockSize; lane++) {
+                //Same as Quaternion::operator*(Vector3)
+                float uvX = qy * v.z[lane] - qz * v.y[lane];
+                float uvY = qz * v.x[lane] - qx * v.z[lane];
+                float uvZ = qx * v.y[lane] - qy * v.x[lane];
+                float uuvX = qy * uvZ - qz * uvY;
+                float uuvY = qz * uvX - qx * uvZ;
+                float uuvZ = qx * uvY - qy * uvX;
+
+                r.x[lane] = v.x[lane] + uvX * qw2 + uuvX * 2.0f;
+                r.y[lane] = v.y[lane] + uvY * qw2 + uuvY * 2.0f;
+                r.z[lane] = v.z[lane] + uvZ * qw2 + uuvZ * 2.0f;
+                r.w[lane] = v.w[lane];
+            }
+            output[b] = r;
+        }
+    }
+
+    void MultiplyQuaternionBlocks(const Vector4Block* a, const Vector4Block* b, Vector4Block* output, size_t blocksCount)
+    {
+        for (size_t i = 0; i < blocksCount; i++) {
+            auto& qa = a[i];
+            auto& qb = b[i];
+            Vector4Block r;
+            for (size_t lane = 0; lane < Vector4BlockSize; lane++) {
+                r.w[lane] = qa.w[lane] * qb.w[lane] - qa.x[lane] * qb.x[lane] - qa.y[lane] * qb.y[lane] - qa.z[lane] * qb.z[lane];
+                r.x[lane] = qa.w[lane] * qb.x[lane] + qa.x[lane] * qb.w[lane] + qa.y[lane] * qb.z[lane] - qa.z[lane] * qb.y[lane];
+                r.y[lane] = qa.w[lane] * qb.y[lane] + qa.y[lane] * qb.w[lane] + qa.z[lane] * qb.x[lane] - qa.x[lane] * qb.z[lane];
+                r.z[lane] = qa.w[lane] * qb.z[lane] + qa.z[lane] * qb.w[lane] + qa.x[lane] * qb.y[lane] - qa.y[lane] * qb.x[lane];
+            }
+            output[i] = r;
+        }
+    }
+
+    void NormalizeBlocks(Vector4Block* blocks, size_t blocksCount)
+    {
+        for (size_t b = 0; b < blocksCount; b++) {
+            auto& v = blocks[b];
+            for (size_t lane = 0; lane < Vector4BlockSize; lane++) {
+                float length = sqrtf(v.x[lane] * v.x[lane] + v.y[lane] * v.y[lane] + v.z[lane] * v.z[lane] + v.w[lane] * v.w[lane]);
+                float inversedLength = 1.0f / length;
+                v.x[lane] *= inversedLength;
+                v.y[lane] *= inversedLength;
+                v.z[lane] *= inversedLength;
+                v.w[lane] *= inversedLength;
+            }
+        }
+    }
+
+    void TransformVectors(const Matrix4& matrix, const Vector4* input, Vector4* output, size_t count)
+    {
+        Vector4Block block;
+        for (size_t first = 0; first < count; first += Vector4BlockSize) {
+            size_t blockCount = (std::min)(count - first, Vector4BlockSize);
+            LoadBlock(input + first, blockCount, block);
+            TransformBlocks(matrix, &block, &block, 1);
+            StoreBlock(block, blockCount, output + first);
+        }
+    }
+
+    void RotateVectors(const Quaternion& rotation, const Vector4* input, Vector4* output, size_t count)
+    {
+        Vector4Block block;
+        for (size_t first = 0; first < count; first += Vector4BlockSize) {
+            size_t blockCount = (std::min)(count - first, Vector4BlockSize);
+            LoadBlock(input + first, blockCount, block);
+            RotateBlocks(rotation, &block, &block, 1);
+            StoreBlock(block, blockCount, output + first);
+        }
+    }
+
+    void NormalizeVectors(Vector4* vectors, size_t count)
+    {
+        Vector4Block block;
+        for (size_t first = 0; first < count; first += Vector4BlockSize) {
+            size_t blockCount = (std::min)(count - first, Vector4BlockSize);
+            LoadBlock(vectors + first, blockCount, block);
+            NormalizeBlocks(&block, 1);
+            StoreBlock(block, blockCount, vectors + first);
+        }
+    }
+}
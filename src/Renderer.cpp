@@ -1,256 +1,801 @@
 #include "Renderer.h"
 #include "gl/GLUtils.h"
+#include "ShaderSources.h"
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
+#include <math.h>
 #include <hairgl/Math.h>
 #include "shaders/ShaderTypes.h"
 
 namespace HairGL
 {
     const std::string GLSLVersion = "#version 430 core\n";
-
-    Renderer::Renderer() :
+    constexpr size_t UniformRingSize = 3 * 64 * 1024;
+    constexpr uint32_t MinSimulationGroupSize = 64;
+    //Positions, rotations, collision bounds padded like vec4 arrays, and collider hits
+    constexpr uint32_t SimulationSharedBytesPerInvocation = 4 * sizeof(Vector4) + sizeof(uint32_t);
+    constexpr uint32_t CullingGroupSize = 64;
+    constexpr uint32_t InteractionGroupSize = 64;
+    constexpr uint32_t RibbonsGroupSize = 64;
+    constexpr uint32_t FollowStrandsGroupSize = 64;
+    //Position and tangent of every control point
+    constexpr size_t FollowStrandPointSize = 2 * sizeof(Vector4);
+    constexpr size_t RibbonPointsChunkSize = 16 * 1024 * 1024;
+    constexpr size_t RibbonPointSize = 2 * sizeof(Vector4);
+
+    Renderer::Renderer(FrameProfiler& profiler, const HairSystemSettings& settings) :
+        profiler(profiler),
         guidesVisualizationProgramID(0),
         growthMeshVisualizationProgramID(0),
         simulationProgramID(0),
+        cullingProgramID(0),
         hairRenderingProgramID(0),
-        emptyVertexArrayID(0)
+        ribbonsComputeProgramID(0),
+        ribbonsRenderingProgramID(0),
+        followStrandsProgramID(0),
+        renderingPipeline(settings.renderingPipeline),
+        programCache(settings.programCacheDirectory),
+        shaderOverrideDirectory(settings.shaderOverrideDirectory),
+        compactStorage(settings.compactStorage),
+        followStrandsCache(settings.followStrandsCache),
+        emptyVertexArrayID(0),
+        uniformRing(nullptr)
     {
         glGenVertexArrays(1, &emptyVertexArrayID);
 
-        glGenBuffers(1, &hairDataBufferID);
-        glBindBuffer(GL_UNIFORM_BUFFER, hairDataBufferID);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(HairRenderData), nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        //Room for three frames of a few dozen instances, the ring grows if a frame needs more
+        uniformRing = new RingBuffer(GL_UNIFORM_BUFFER, UniformRingSize);
+
+        glGenBuffers(1, &simulationSlotsBufferID);
+        glGenBuffers(1, &collidersBufferID);
+        glGenBuffers(1, &interactionGridBufferID);
+        interactionGridResolution = settings.interactionGridResolution;
+        interactionGridAllocated = false;
+        glGenBuffers(1, &drawCommandsBufferID);
+        glGenBuffers(1, &visibleTrianglesBufferID);
+        visibleTrianglesCapacity = 0;
+
+        glGenBuffers(1, &ribbonPointsBufferID);
+        glGenBuffers(1, &ribbonDrawCommandsBufferID);
+        glGenBuffers(1, &ribbonIndicesBufferID);
+        ribbonPointsCapacity = 0;
+        ribbonDrawCommandsCapacity = 0;
+        ribbonIndicesLinesCount = 0;
+        ribbonIndicesPointsPerLine = 0;
+
+        glGenBuffers(1, &followStrandsBufferID);
+        followStrandsCapacity = 0;
+
+        //Short strands are packed several to a workgroup, a strand never spans two of them
+        simulationGroupSize = MinSimulationGroupSize;
+        while (simulationGroupSize < settings.maxStrandVertices) {
+            simulationGroupSize *= 2;
+        }
 
-        glGenBuffers(1, &sceneDataBufferID);
-        glBindBuffer(GL_UNIFORM_BUFFER, sceneDataBufferID);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(SceneRenderData), nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        GLint maxInvocations = 0;
+        GLint maxSharedMemorySize = 0;
+        glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+        glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &maxSharedMemorySize);
+        if (simulationGroupSize > (uint32_t)maxInvocations || simulationGroupSize * SimulationSharedBytesPerInvocation > (uint32_t)maxSharedMemorySize) {
+            throw std::runtime_error("maxStrandVertices exceeds the compute workgroup size of the device.");
+        }
 
-        glGenBuffers(1, &lightDataBufferID);
-        glBindBuffer(GL_UNIFORM_BUFFER, lightDataBufferID);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightRenderData), nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        GLint maxWorkGroups = 0;
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxWorkGroups);
+        maxWorkGroupsX = maxWorkGroups;
 
-        shaderIncludeSrc = LoadFile("hairglshaders/ShaderTypes.h");
+        shaderIncludeSrc = LoadShader("ShaderTypes.h");
+        hairIncludeSrc = shaderIncludeSrc + LoadShader("HairStrands.glsl");
 
         guidesVisualizationProgramID = CreateGuidesVisualizationProgram();
         growthMeshVisualizationProgramID = CreateGrowthMeshVisualizationProgram();
         simulationProgramID = CreateSimulationProgram();
-        hairRenderingProgramID = CreateHairRenderingProgram();
+        interactionSplatProgramID = CreateInteractionProgram(true);
+        interactionApplyProgramID = CreateInteractionProgram(false);
+        cullingProgramID = CreateCullingProgram();
+
+        if (renderingPipeline == HairRenderingPipeline::Compute) {
+            ribbonsComputeProgramID = CreateRibbonsComputeProgram();
+            ribbonsRenderingProgramID = CreateRibbonsRenderingProgram();
+        }
+        else {
+            hairRenderingProgramID = CreateHairRenderingProgram();
+        }
+
+        if (followStrandsCache) {
+            followStrandsProgramID = CreateFollowStrandsProgram();
+            followStrandsDrawIndexUniform = glGetUniformLocation(followStrandsProgramID, "drawIndex");
+        }
+
+        //Locations are resolved once, Simulate and Render only set values
+        simulationUniforms.firstInstance = glGetUniformLocation(simulationProgramID, "firstInstance");
+        simulationUniforms.guidesCount = glGetUniformLocation(simulationProgramID, "guidesCount");
+        simulationUniforms.verticesPerStrand = glGetUniformLocation(simulationProgramID, "verticesPerStrand");
+        simulationUniforms.strandsPerGroup = glGetUniformLocation(simulationProgramID, "strandsPerGroup");
+        simulationUniforms.timeStep = glGetUniformLocation(simulationProgramID, "timeStep");
+        simulationUniforms.gravity = glGetUniformLocation(simulationProgramID, "gravity");
+        simulationUniforms.lengthConstraintIterations = glGetUniformLocation(simulationProgramID, "lengthConstraintIterations");
+        simulationUniforms.localShapeIterations = glGetUniformLocation(simulationProgramID, "localShapeIterations");
+        simulationUniforms.restBoundsMin = glGetUniformLocation(simulationProgramID, "restBoundsMin");
+        simulationUniforms.restBoundsSize = glGetUniformLocation(simulationProgramID, "restBoundsSize");
+
+        for (auto programID : { interactionSplatProgramID, interactionApplyProgramID }) {
+            auto& uniforms = programID == interactionSplatProgramID ? interactionSplatUniforms : interactionApplyUniforms;
+            uniforms.verticesCount = glGetUniformLocation(programID, "verticesCount");
+            uniforms.gridResolution = glGetUniformLocation(programID, "gridResolution");
+            uniforms.gridOrigin = glGetUniformLocation(programID, "gridOrigin");
+            uniforms.cellSize = glGetUniformLocation(programID, "cellSize");
+            uniforms.volumeStiffness = glGetUniformLocation(programID, "volumeStiffness");
+            uniforms.hairFriction = glGetUniformLocation(programID, "hairFriction");
+        }
+
+        cullingUniforms.trianglesCount = glGetUniformLocation(cullingProgramID, "trianglesCount");
+        cullingUniforms.verticesPerStrand = glGetUniformLocation(cullingProgramID, "verticesPerStrand");
+        cullingUniforms.drawIndex = glGetUniformLocation(cullingProgramID, "drawIndex");
+        cullingUniforms.visibleTrianglesOffset = glGetUniformLocation(cullingProgramID, "visibleTrianglesOffset");
+        cullingUniforms.margin = glGetUniformLocation(cullingProgramID, "margin");
+        cullingUniforms.interpolationFactor = glGetUniformLocation(cullingProgramID, "interpolationFactor");
+
+        if (renderingPipeline == HairRenderingPipeline::Compute) {
+            ribbonsUniforms.drawIndex = glGetUniformLocation(ribbonsComputeProgramID, "drawIndex");
+            ribbonsUniforms.ribbonDrawIndex = glGetUniformLocation(ribbonsComputeProgramID, "ribbonDrawIndex");
+            ribbonsUniforms.firstPatch = glGetUniformLocation(ribbonsComputeProgramID, "firstPatch");
+            ribbonsUniforms.patchesCount = glGetUniformLocation(ribbonsComputeProgramID, "patchesCount");
+            ribbonsUniforms.linesCount = glGetUniformLocation(ribbonsComputeProgramID, "linesCount");
+            ribbonsUniforms.pointsPerLine = glGetUniformLocation(ribbonsComputeProgramID, "pointsPerLine");
+            ribbonsPointsPerPatchUniform = glGetUniformLocation(ribbonsRenderingProgramID, "pointsPerPatch");
+        }
+
+        guidesVisualizationUniforms.viewProjectionMatrix = glGetUniformLocation(guidesVisualizationProgramID, "viewProjectionMatrix");
+        guidesVisualizationUniforms.doubleSegments = glGetUniformLocation(guidesVisualizationProgramID, "doubleSegments");
+        guidesVisualizationUniforms.verticesPerStrand = glGetUniformLocation(guidesVisualizationProgramID, "verticesPerStrand");
+        guidesVisualizationUniforms.color = glGetUniformLocation(guidesVisualizationProgramID, "color");
+
+        growthMeshVisualizationUniforms.viewProjectionMatrix = glGetUniformLocation(growthMeshVisualizationProgramID, "viewProjectionMatrix");
+        growthMeshVisualizationUniforms.doubleSegments = -1;
+        growthMeshVisualizationUniforms.verticesPerStrand = glGetUniformLocation(growthMeshVisualizationProgramID, "verticesPerStrand");
+        growthMeshVisualizationUniforms.color = glGetUniformLocation(growthMeshVisualizationProgramID, "color");
     }
 
-    void Renderer::Simulate(HairInstance* instance, float timeStep) const
+    void Renderer::UpdateSimulationParams(HairInstance* const* instances, size_t count, float timeStep) const
     {
-        auto asset = instance->asset;
+        for (size_t i = 0; i < count; i++) {
+            auto instance = instances[i];
+            auto& pool = instance->asset->instancePool;
+
+            if (pool.simulationParamsCapacity < pool.capacity) {
+                //The slots of a grown pool are uploaded again, so the old contents are not copied
+                if (pool.simulationParamsBufferID == 0) {
+                    glGenBuffers(1, &pool.simulationParamsBufferID);
+                }
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, pool.simulationParamsBufferID);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, pool.capacity * sizeof(SimulationParams), nullptr, GL_DYNAMIC_DRAW);
+                pool.simulationParamsCapacity = pool.capacity;
+
+                for (auto slotInstance : pool.slots) {
+                    if (slotInstance) {
+                        slotInstance->simulationParamsDirty = true;
+                    }
+                }
+            }
+        }
 
-        glUseProgram(simulationProgramID);
+        for (size_t i = 0; i < count; i++) {
+            auto instance = instances[i];
+            if (!instance->simulationParamsDirty) {
+                continue;
+            }
+
+            //Only settings feed these values, the wind pyramid does not vary with the frame
+            auto parameters = CreateSimulationParameters(instance, timeStep);
+            SimulationParams params = {};
+            params.windPyramid = parameters.windPyramid;
+            params.globalStiffness = parameters.globalStiffness;
+            params.localStiffness = parameters.localStiffness;
+            params.damping = parameters.damping;
+            params.positionsOffset = GetPositionsOffset(instance) / sizeof(Vector4);
+
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance->asset->instancePool.simulationParamsBufferID);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, instance->poolSlot * sizeof(SimulationParams), sizeof(SimulationParams), &params);
+
+            instance->simulationParamsDirty = false;
+        }
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REST_POSITIONS_BUFFER_BINDING, asset->restPositionsBufferID);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, instance->positionsBufferID);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PREVIOUS_POSITIONS_BUFFER_BINDING, instance->previousPositionsBufferID);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TANGENTS_DISTANCES_BINDING, asset->tangentsDistancesBufferID);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REF_VECTORS_BINDING, asset->refVectorsBufferID);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLOBAL_ROTATIONS_BINDING, asset->globalRotationsBufferID);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEBUG_BUFFER_BINDING, asset->debugBufferID);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    void Renderer::Simulate(HairInstance* const* instances, size_t count, float timeStep) const
+    {
+        if (count == 0) {
+            return;
+        }
+
+        //Instances of the same asset share their buffers and are simulated by one dispatch
+        std::vector<HairInstance*> sortedInstances(instances, instances + count);
+        std::stable_sort(sortedInstances.begin(), sortedInstances.end(), [](const HairInstance* a, const HairInstance* b) {
+            return a->asset < b->asset;
+        });
+
+        UpdateSimulationParams(sortedInstances.data(), count, timeStep);
+
+        //Colliders follow the skeleton, so those of every instance are uploaded again each step
+        std::vector<SimulationSlot> slots(count);
+        std::vector<Collider> colliders;
+        for (size_t i = 0; i < count; i++) {
+            auto instance = sortedInstances[i];
+            slots[i].poolSlot = instance->poolSlot;
+            slots[i].positionsBuffer = instance->positionsBuffer;
+            slots[i].firstCollider = colliders.size();
+            slots[i].collidersCount = instance->colliders.size();
+
+            for (auto& instanceCollider : instance->colliders) {
+                Collider collider = {};
+                collider.start = instanceCollider.start;
+                collider.radius = instanceCollider.radius;
+                collider.end = instanceCollider.end;
+                colliders.push_back(collider);
+            }
+        }
+
+        //Never empty, so there is always a buffer store to bind
+        if (colliders.empty()) {
+            colliders.push_back(Collider());
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, simulationSlotsBufferID);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, slots.size() * sizeof(SimulationSlot), slots.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, collidersBufferID);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, colliders.size() * sizeof(Collider), colliders.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glUseProgram(simulationProgramID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SIMULATION_SLOTS_BINDING, simulationSlotsBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COLLIDERS_BINDING, collidersBufferID);
+
+        auto parameters = CreateSimulationParameters(sortedInstances[0], timeStep);
+        glUniform1f(simulationUniforms.timeStep, parameters.timeStep);
+        glUniform3fv(simulationUniforms.gravity, 1, parameters.gravity.m);
+        glUniform1i(simulationUniforms.lengthConstraintIterations, parameters.lengthConstraintIterations);
+        glUniform1i(simulationUniforms.localShapeIterations, parameters.localShapeIterations);
+
+        for (size_t first = 0; first < count;) {
+            auto asset = sortedInstances[first]->asset;
+            size_t last = first + 1;
+            while (last < count && sortedInstances[last]->asset == asset) {
+                last++;
+            }
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REST_POSITIONS_BUFFER_BINDING, asset->restPositionsBufferID);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, asset->instancePool.positionsBufferIDs[0]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PREVIOUS_POSITIONS_BUFFER_BINDING, asset->instancePool.positionsBufferIDs[1]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TANGENTS_DISTANCES_BINDING, asset->tangentsDistancesBufferID);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REF_VECTORS_BINDING, asset->refVectorsBufferID);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GLOBAL_ROTATIONS_BINDING, asset->globalRotationsBufferID);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEBUG_BUFFER_BINDING, asset->debugBufferID);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SIMULATION_PARAMS_BINDING, asset->instancePool.simulationParamsBufferID);
+
+            uint32_t verticesPerStrand = asset->segmentsCount + 1;
+            uint32_t strandsPerGroup = simulationGroupSize / verticesPerStrand;
+            uint32_t groupsCount = (asset->guidesCount + strandsPerGroup - 1) / strandsPerGroup;
+
+            glUniform1i(simulationUniforms.firstInstance, first);
+            glUniform1i(simulationUniforms.guidesCount, asset->guidesCount);
+            glUniform1i(simulationUniforms.verticesPerStrand, verticesPerStrand);
+            glUniform1i(simulationUniforms.strandsPerGroup, strandsPerGroup);
+            if (compactStorage) {
+                glUniform3fv(simulationUniforms.restBoundsMin, 1, asset->restBoundsMin.m);
+                glUniform3fv(simulationUniforms.restBoundsSize, 1, asset->restBoundsSize.m);
+            }
+
+            if (groupsCount > 0) {
+                //Groups beyond the x limit wrap into z, the shader flattens both back into one index
+                uint32_t groupsX = (std::min)(groupsCount, maxWorkGroupsX);
+                uint32_t groupsZ = (groupsCount + groupsX - 1) / groupsX;
+
+                profiler.BeginGPUQuery(GPUScope::Simulation, sortedInstances.data() + first, last - first);
+                glDispatchCompute(groupsX, last - first, groupsZ);
+                profiler.EndGPUQuery();
+            }
+
+            first = last;
+        }
 
-        int verticesPerStrand = asset->segmentsCount + 1;
-		auto windPyramid = CreateWindPyramid(instance->settings.wind, instance->simulationFrame);
-        glUniformMatrix4fv(glGetUniformLocation(simulationProgramID, "modelMatrix"), 1, false, (float*)instance->settings.modelMatrix.m);
-        glUniform1i(glGetUniformLocation(simulationProgramID, "verticesPerStrand"), verticesPerStrand);
-        glUniform1f(glGetUniformLocation(simulationProgramID, "timeStep"), timeStep);
-        glUniform1f(glGetUniformLocation(simulationProgramID, "globalStiffness"), instance->settings.globalStiffness);
-		glUniform1f(glGetUniformLocation(simulationProgramID, "localStiffness"), (std::min)(instance->settings.localStiffness, 0.95f) * 0.5f);
-        glUniform1f(glGetUniformLocation(simulationProgramID, "damping"), instance->settings.damping);
-        glUniform3f(glGetUniformLocation(simulationProgramID, "gravity"), 0.0f, -9.8f, 0.0f);
-        glUniform1i(glGetUniformLocation(simulationProgramID, "lengthConstraintIterations"), 5);
-		glUniform1i(glGetUniformLocation(simulationProgramID, "localShapeIterations"), 10);
-		glUniformMatrix4fv(glGetUniformLocation(simulationProgramID, "windPyramid"), 1, false, (float*)windPyramid.m);
-
-        glDispatchCompute(instance->asset->guidesCount, 1, 1);
         glUseProgram(0);
 
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-		instance->simulationFrame++;
+        for (size_t i = 0; i < count; i++) {
+            instances[i]->positionsBuffer = 1 - instances[i]->positionsBuffer;
+            instances[i]->simulationFrame++;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (HasHairInteraction(sortedInstances[i]->settings)) {
+                ApplyHairInteraction(sortedInstances[i]);
+            }
+        }
     }
 
-    void Renderer::Render(const HairInstance* instance, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const
+    //Instances are handled one at a time, they all share the grid
+    void Renderer::ApplyHairInteraction(const HairInstance* instance) const
     {
         auto asset = instance->asset;
-        auto settings = instance->settings;
+        uint32_t verticesCount = asset->guidesCount * (asset->segmentsCount + 1);
+        if (verticesCount == 0) {
+            return;
+        }
+
+        auto grid = GetInteractionGrid(asset, interactionGridResolution);
+        size_t cellsCount = (size_t)grid.resolution * grid.resolution * grid.resolution;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, interactionGridBufferID);
+        if (!interactionGridAllocated) {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, cellsCount * 4 * sizeof(int32_t), nullptr, GL_DYNAMIC_DRAW);
+            interactionGridAllocated = true;
+        }
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        size_t positionsOffset = GetPositionsOffset(instance);
+        size_t positionsSize = GetPositionsSize(instance);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, GetPositionsBufferID(instance), positionsOffset, positionsSize);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, PREVIOUS_POSITIONS_BUFFER_BINDING, GetPreviousPositionsBufferID(instance), positionsOffset, positionsSize);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INTERACTION_GRID_BINDING, interactionGridBufferID);
+
+        uint32_t groupsCount = (verticesCount + InteractionGroupSize - 1) / InteractionGroupSize;
+        uint32_t groupsX = (std::min)(groupsCount, maxWorkGroupsX);
+        uint32_t groupsZ = (groupsCount + groupsX - 1) / groupsX;
+
+        profiler.BeginGPUQuery(GPUScope::Simulation, &instance, 1);
+        for (auto programID : { interactionSplatProgramID, interactionApplyProgramID }) {
+            auto& uniforms = programID == interactionSplatProgramID ? interactionSplatUniforms : interactionApplyUniforms;
+            glUseProgram(programID);
+            glUniform1i(uniforms.verticesCount, verticesCount);
+            glUniform1i(uniforms.gridResolution, grid.resolution);
+            glUniform3fv(uniforms.gridOrigin, 1, grid.origin.m);
+            glUniform3fv(uniforms.cellSize, 1, grid.cellSize.m);
+            glUniform1f(uniforms.volumeStiffness, instance->settings.volumeStiffness);
+            glUniform1f(uniforms.hairFriction, instance->settings.hairFriction);
+
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            glDispatchCompute(groupsX, 1, groupsZ);
+        }
+        profiler.EndGPUQuery();
+
+        glUseProgram(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void Renderer::Render(const HairInstance* const* instances, size_t count, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const
+    {
         auto viewProjectionMatrix = projectionMatrix * viewMatrix;
-        int verticesPerStrand = asset->segmentsCount + 1;
+        auto inversedViewMatrix = viewMatrix.EuclidianInversed();
+
+        SceneRenderData sceneRenderData = {};
+        sceneRenderData.viewProjectionMatrix = viewProjectionMatrix;
+        sceneRenderData.eyePosition = inversedViewMatrix.m[3].XYZ();
+        sceneRenderData.projectionScale = projectionMatrix.m[1][1];
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        sceneRenderData.viewportHeight = (float)viewport[3];
+
+        LightRenderData lightData = {};
+        lightData.lightsCount = 1;
+        lightData.lights[0].position = { 5, 5, 5 };
+        lightData.lights[0].color = { 1, 1, 1, 1 };
+
+        //Uniform data of the whole call goes into the ring and is fenced once
+        uniformRing->Reserve(uniformRing->Align(sizeof(SceneRenderData)) + uniformRing->Align(sizeof(LightRenderData)) +
+            count * uniformRing->Align(sizeof(HairRenderData)));
+        size_t sceneDataOffset = uniformRing->Write(&sceneRenderData, sizeof(SceneRenderData));
+        size_t lightDataOffset = uniformRing->Write(&lightData, sizeof(LightRenderData));
+
+        std::vector<InstanceDrawData> drawData(count);
+        CullInstances(instances, count, sceneDataOffset, drawData);
+
+        if (renderingPipeline == HairRenderingPipeline::Compute) {
+            //Every chunk gets its own command, so no draw reads a command a later chunk rewrites
+            size_t ribbonDrawsCount = 0;
+            for (size_t i = 0; i < count; i++) {
+                drawData[i].firstRibbonDraw = ribbonDrawsCount;
+                ribbonDrawsCount += GetRibbonsLayout(instances[i]).chunksCount;
+            }
+
+            if (ribbonDrawCommandsCapacity < ribbonDrawsCount) {
+                ribbonDrawCommandsCapacity = (std::max)(ribbonDrawsCount, ribbonDrawCommandsCapacity * 2);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, ribbonDrawCommandsBufferID);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, ribbonDrawCommandsCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
+        }
 
         glEnable(GL_DEPTH_TEST);
+
+        for (size_t i = 0; i < count; i++) {
+            auto start = ProfilerClock::now();
+            RenderInstance(instances[i], viewProjectionMatrix, sceneDataOffset, lightDataOffset, drawData[i]);
+            profiler.AddRenderCPUTime(instances[i], GetElapsedTime(start));
+        }
+
+        uniformRing->Fence();
+    }
+
+    RibbonsLayout Renderer::GetRibbonsLayout(const HairInstance* instance) const
+    {
+        //Room for the full detail, the isoline tesselator rounds both levels up
+        RibbonsLayout layout = {};
+        if (!instance->settings.renderHair) {
+            return layout;
+        }
+
+        layout.linesCount = (std::max)(1.0f, ceilf(instance->settings.density));
+        layout.pointsPerLine = (std::max)(1.0f, ceilf(instance->settings.tesselationFactor)) + 1;
+
+        size_t patchSize = layout.linesCount * layout.pointsPerLine * RibbonPointSize;
+        size_t patchesCount = instance->asset->trianglesCount * instance->asset->segmentsCount;
+        layout.patchesPerChunk = (std::max)((size_t)1, RibbonPointsChunkSize / patchSize);
+        layout.chunksCount = (patchesCount + layout.patchesPerChunk - 1) / layout.patchesPerChunk;
+        return layout;
+    }
+
+    void Renderer::CullInstances(const HairInstance* const* instances, size_t count, size_t sceneDataOffset, std::vector<InstanceDrawData>& drawData) const
+    {
+        //Every instance gets a draw command and a range of the visible triangles buffer, culling only fills them in
+        size_t visibleTrianglesCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            drawData[i].drawIndex = i;
+            drawData[i].visibleTrianglesOffset = visibleTrianglesCount;
+            visibleTrianglesCount += instances[i]->asset->trianglesCount;
+        }
+
+        std::vector<DrawArraysIndirectCommand> drawCommands(count);
+        for (auto& drawCommand : drawCommands) {
+            drawCommand.instanceCount = 1;
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCommandsBufferID);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(DrawArraysIndirectCommand), drawCommands.data(), GL_STREAM_DRAW);
+
+        if (visibleTrianglesCapacity < visibleTrianglesCount) {
+            visibleTrianglesCapacity = (std::max)(visibleTrianglesCount, visibleTrianglesCapacity * 2);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleTrianglesBufferID);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, visibleTrianglesCapacity * sizeof(int32_t), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glUseProgram(cullingProgramID);
+        glBindBufferRange(GL_UNIFORM_BUFFER, SCENE_DATA_BINDING, uniformRing->GetBufferID(), sceneDataOffset, sizeof(SceneRenderData));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_TRIANGLES_BINDING, visibleTrianglesBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_BINDING, drawCommandsBufferID);
+
+        for (size_t i = 0; i < count; i++) {
+            auto instance = instances[i];
+            auto asset = instance->asset;
+            auto& settings = instance->settings;
+            if (!settings.renderHair || asset->trianglesCount == 0 || asset->segmentsCount == 0) {
+                continue;
+            }
+
+            //Bounds grow by half of the widest strand, including the widening of the LOD
+            float margin = (std::max)(settings.rootWidth, settings.tipWidth) * 0.5f;
+            if (settings.lodEnabled) {
+                margin *= ceilf(settings.density) / (std::max)(1.0f, ceilf((std::min)(settings.lodMinDensity, settings.density)));
+            }
+
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, GetPositionsBufferID(instance), GetPositionsOffset(instance), GetPositionsSize(instance));
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, PREVIOUS_POSITIONS_BUFFER_BINDING, GetPreviousPositionsBufferID(instance), GetPositionsOffset(instance), GetPositionsSize(instance));
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HAIR_INDICES_BUFFER_BINDING, asset->hairIndicesBufferID);
+
+            glUniform1i(cullingUniforms.trianglesCount, asset->trianglesCount);
+            glUniform1i(cullingUniforms.verticesPerStrand, asset->segmentsCount + 1);
+            glUniform1i(cullingUniforms.drawIndex, i);
+            glUniform1i(cullingUniforms.visibleTrianglesOffset, drawData[i].visibleTrianglesOffset);
+            glUniform1f(cullingUniforms.margin, margin);
+            glUniform1f(cullingUniforms.interpolationFactor, instance->interpolationFactor);
+
+            uint32_t groupsCount = (asset->trianglesCount + CullingGroupSize - 1) / CullingGroupSize;
+            uint32_t groupsX = (std::min)(groupsCount, maxWorkGroupsX);
+            uint32_t groupsZ = (groupsCount + groupsX - 1) / groupsX;
+
+            profiler.BeginGPUQuery(GPUScope::Culling, &instance, 1);
+            glDispatchCompute(groupsX, 1, groupsZ);
+            profiler.EndGPUQuery();
+        }
+
+        glUseProgram(0);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    void Renderer::RenderInstance(const HairInstance* instance, const Matrix4& viewProjectionMatrix, size_t sceneDataOffset, size_t lightDataOffset,
+        const InstanceDrawData& drawData) const
+    {
+        auto asset = instance->asset;
+        auto settings = instance->settings;
+        int verticesPerStrand = asset->segmentsCount + 1;
+        size_t positionsOffset = GetPositionsOffset(instance);
+        size_t positionsSize = GetPositionsSize(instance);
+
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REST_POSITIONS_BUFFER_BINDING, asset->restPositionsBufferID);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, instance->positionsBufferID);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PREVIOUS_POSITIONS_BUFFER_BINDING, instance->previousPositionsBufferID);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, GetPositionsBufferID(instance), positionsOffset, positionsSize);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, PREVIOUS_POSITIONS_BUFFER_BINDING, GetPreviousPositionsBufferID(instance), positionsOffset, positionsSize);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HAIR_INDICES_BUFFER_BINDING, asset->hairIndicesBufferID);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TANGENTS_DISTANCES_BINDING, asset->tangentsDistancesBufferID);
 
         if (settings.visualizeGuides) {
             glUseProgram(guidesVisualizationProgramID);
 
-            glUniformMatrix4fv(glGetUniformLocation(guidesVisualizationProgramID, "viewProjectionMatrix"), 1, false, (float*)viewProjectionMatrix.m);
-            glUniform1i(glGetUniformLocation(guidesVisualizationProgramID, "doubleSegments"), asset->segmentsCount * 2);
-            glUniform1i(glGetUniformLocation(guidesVisualizationProgramID, "verticesPerStrand"), verticesPerStrand);
-            glUniform4f(glGetUniformLocation(guidesVisualizationProgramID, "color"), 1, 0, 0, 1);
+            glUniformMatrix4fv(guidesVisualizationUniforms.viewProjectionMatrix, 1, false, (float*)viewProjectionMatrix.m);
+            glUniform1i(guidesVisualizationUniforms.doubleSegments, asset->segmentsCount * 2);
+            glUniform1i(guidesVisualizationUniforms.verticesPerStrand, verticesPerStrand);
+            glUniform4f(guidesVisualizationUniforms.color, 1, 0, 0, 1);
 
             glBindVertexArray(emptyVertexArrayID);
+            profiler.BeginGPUQuery(GPUScope::Guides, &instance, 1);
             glDrawArrays(GL_LINES, 0, asset->guidesCount * asset->segmentsCount * 2);
+            profiler.EndGPUQuery();
             glUseProgram(0);
         }
 
         if (instance->settings.visualizeGrowthMesh) {
             glUseProgram(growthMeshVisualizationProgramID);
 
-            glUniformMatrix4fv(glGetUniformLocation(growthMeshVisualizationProgramID, "viewProjectionMatrix"), 1, false, (float*)viewProjectionMatrix.m);
-            glUniform1i(glGetUniformLocation(growthMeshVisualizationProgramID, "verticesPerStrand"), verticesPerStrand);
-            glUniform4f(glGetUniformLocation(growthMeshVisualizationProgramID, "color"), 1, 1, 0, 1);
+            glUniformMatrix4fv(growthMeshVisualizationUniforms.viewProjectionMatrix, 1, false, (float*)viewProjectionMatrix.m);
+            glUniform1i(growthMeshVisualizationUniforms.verticesPerStrand, verticesPerStrand);
+            glUniform4f(growthMeshVisualizationUniforms.color, 1, 1, 0, 1);
 
             glBindVertexArray(emptyVertexArrayID);
+            profiler.BeginGPUQuery(GPUScope::GrowthMesh, &instance, 1);
             glDrawArrays(GL_LINES, 0, asset->trianglesCount * 6);
+            profiler.EndGPUQuery();
             glUseProgram(0);
         }
 
         if (instance->settings.renderHair) {
-            auto inversedViewMatrix = viewMatrix.EuclidianInversed();
-
             HairRenderData hairRenderData = {};
             hairRenderData.tesselationFactor = settings.tesselationFactor;
             hairRenderData.segmentsCount = instance->asset->segmentsCount;
             hairRenderData.rootWidth = settings.rootWidth;
             hairRenderData.tipWidth = settings.tipWidth;
             hairRenderData.density = settings.density;
+            hairRenderData.visibleTrianglesOffset = drawData.visibleTrianglesOffset;
             hairRenderData.color = settings.color;
             hairRenderData.ambient = settings.ambient;
             hairRenderData.diffuse = settings.diffuse;
             hairRenderData.specular = settings.specular;
             hairRenderData.specularPower = settings.specularPower;
             hairRenderData.thinningStart = settings.thinningStart;
+            hairRenderData.interpolationFactor = instance->interpolationFactor;
+            hairRenderData.lodEnabled = settings.lodEnabled ? 1 : 0;
+            hairRenderData.lodMinDensity = settings.lodMinDensity;
+            hairRenderData.lodMinTesselationFactor = settings.lodMinTesselationFactor;
+            hairRenderData.lodFullDetailSize = settings.lodFullDetailSize;
 
-            SceneRenderData sceneRenderData = {};
-            sceneRenderData.viewProjectionMatrix = viewProjectionMatrix;
-            sceneRenderData.eyePosition = inversedViewMatrix.m[3].XYZ();
+            size_t hairDataOffset = uniformRing->Write(&hairRenderData, sizeof(HairRenderData));
 
-            LightRenderData lightData = {};
-            lightData.lightsCount = 1;
-            lightData.lights[0].position = { 5, 5, 5 };
-            lightData.lights[0].color = { 1, 1, 1, 1 };
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, GetPositionsBufferID(instance), positionsOffset, positionsSize);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HAIR_INDICES_BUFFER_BINDING, asset->hairIndicesBufferID);
 
-            glBindBuffer(GL_UNIFORM_BUFFER, hairDataBufferID);
-            glBufferData(GL_UNIFORM_BUFFER, sizeof(HairRenderData), &hairRenderData, GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            uint32_t uniformRingID = uniformRing->GetBufferID();
+            glBindBufferRange(GL_UNIFORM_BUFFER, HAIR_DATA_BINDING, uniformRingID, hairDataOffset, sizeof(HairRenderData));
+            glBindBufferRange(GL_UNIFORM_BUFFER, SCENE_DATA_BINDING, uniformRingID, sceneDataOffset, sizeof(SceneRenderData));
+            glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, uniformRingID, lightDataOffset, sizeof(LightRenderData));
 
-            glBindBuffer(GL_UNIFORM_BUFFER, sceneDataBufferID);
-            glBufferData(GL_UNIFORM_BUFFER, sizeof(SceneRenderData), &sceneRenderData, GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_TRIANGLES_BINDING, visibleTrianglesBufferID);
+            glBindVertexArray(emptyVertexArrayID);
 
-            glBindBuffer(GL_UNIFORM_BUFFER, lightDataBufferID);
-            glBufferData(GL_UNIFORM_BUFFER, sizeof(LightRenderData), &lightData, GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            profiler.BeginGPUQuery(GPUScope::Hair, &instance, 1);
+            if (followStrandsCache) {
+                BuildFollowStrands(instance, drawData);
+            }
+            if (renderingPipeline == HairRenderingPipeline::Compute) {
+                DrawRibbons(instance, drawData);
+            }
+            else {
+                glUseProgram(hairRenderingProgramID);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandsBufferID);
+                glPatchParameteri(GL_PATCH_VERTICES, 1);
+                glDrawArraysIndirect(GL_PATCHES, (const void*)(drawData.drawIndex * sizeof(DrawArraysIndirectCommand)));
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            }
+            profiler.EndGPUQuery();
+            glUseProgram(0);
+        }
+    }
 
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITIONS_BUFFER_BINDING, instance->positionsBufferID);
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HAIR_INDICES_BUFFER_BINDING, asset->hairIndicesBufferID);
+    void Renderer::DrawRibbons(const HairInstance* instance, const InstanceDrawData& drawData) const
+    {
+        auto layout = GetRibbonsLayout(instance);
+        uint32_t pointsPerPatch = layout.linesCount * layout.pointsPerLine;
+        size_t chunkSize = (size_t)layout.patchesPerChunk * pointsPerPatch * RibbonPointSize;
+
+        if (ribbonPointsCapacity < chunkSize) {
+            ribbonPointsCapacity = chunkSize;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, ribbonPointsBufferID);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, ribbonPointsCapacity, nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
 
-            glUseProgram(hairRenderingProgramID);
+        //The indices of one patch are shared by all patches with the same layout, each patch is an instance
+        if (ribbonIndicesLinesCount != layout.linesCount || ribbonIndicesPointsPerLine != layout.pointsPerLine) {
+            std::vector<uint32_t> indices;
+            indices.reserve(layout.linesCount * (layout.pointsPerLine - 1) * 6);
+            for (uint32_t line = 0; line < layout.linesCount; line++) {
+                for (uint32_t point = 0; point + 1 < layout.pointsPerLine; point++) {
+                    uint32_t bottom = (line * layout.pointsPerLine + point) * 2;
+                    uint32_t top = bottom + 2;
+                    indices.insert(indices.end(), { bottom, top, bottom + 1, top, top + 1, bottom + 1 });
+                }
+            }
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ribbonIndicesBufferID);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+            ribbonIndicesLinesCount = layout.linesCount;
+            ribbonIndicesPointsPerLine = layout.pointsPerLine;
+        }
 
-            glBindBufferRange(GL_UNIFORM_BUFFER, HAIR_DATA_BINDING, hairDataBufferID, 0, sizeof(HairRenderData));
-            glBindBufferRange(GL_UNIFORM_BUFFER, SCENE_DATA_BINDING, sceneDataBufferID, 0, sizeof(SceneRenderData));
-            glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, lightDataBufferID, 0, sizeof(LightRenderData));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_BINDING, drawCommandsBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RIBBON_POINTS_BINDING, ribbonPointsBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RIBBON_DRAW_COMMANDS_BINDING, ribbonDrawCommandsBufferID);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ribbonIndicesBufferID);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ribbonDrawCommandsBufferID);
+
+        uint32_t groupsCount = (layout.patchesPerChunk * pointsPerPatch + RibbonsGroupSize - 1) / RibbonsGroupSize;
+        uint32_t groupsX = (std::min)(groupsCount, maxWorkGroupsX);
+        uint32_t groupsZ = (groupsCount + groupsX - 1) / groupsX;
+
+        //Chunks past the visible patches write empty commands, the count is only known on the GPU
+        for (uint32_t chunk = 0; chunk < layout.chunksCount; chunk++) {
+            size_t ribbonDrawIndex = drawData.firstRibbonDraw + chunk;
+
+            //The previous chunk is drawn from the same points
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            glUseProgram(ribbonsComputeProgramID);
+            glUniform1i(ribbonsUniforms.drawIndex, drawData.drawIndex);
+            glUniform1i(ribbonsUniforms.ribbonDrawIndex, ribbonDrawIndex);
+            glUniform1i(ribbonsUniforms.firstPatch, chunk * layout.patchesPerChunk);
+            glUniform1i(ribbonsUniforms.patchesCount, layout.patchesPerChunk);
+            glUniform1i(ribbonsUniforms.linesCount, layout.linesCount);
+            glUniform1i(ribbonsUniforms.pointsPerLine, layout.pointsPerLine);
+            glDispatchCompute(groupsX, 1, groupsZ);
+
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+            glUseProgram(ribbonsRenderingProgramID);
+            glUniform1i(ribbonsPointsPerPatchUniform, pointsPerPatch);
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(ribbonDrawIndex * sizeof(DrawElementsIndirectCommand)));
+        }
 
-            glPatchParameteri(GL_PATCH_VERTICES, 1);
-            glDrawArrays(GL_PATCHES, 0, asset->trianglesCount * asset->segmentsCount);
-            glUseProgram(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    void Renderer::BuildFollowStrands(const HairInstance* instance, const InstanceDrawData& drawData) const
+    {
+        //Sized for every triangle at full density, only the visible ones are written
+        auto asset = instance->asset;
+        size_t linesCount = (std::max)(1.0f, ceilf(instance->settings.density));
+        size_t strandsCount = asset->trianglesCount * linesCount;
+        size_t requiredSize = strandsCount * (asset->segmentsCount + 1) * FollowStrandPointSize;
+
+        if (followStrandsCapacity < requiredSize) {
+            followStrandsCapacity = requiredSize;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, followStrandsBufferID);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, followStrandsCapacity, nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
         }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_BINDING, drawCommandsBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FOLLOW_STRANDS_BINDING, followStrandsBufferID);
+
+        uint32_t groupsCount = (strandsCount + FollowStrandsGroupSize - 1) / FollowStrandsGroupSize;
+        uint32_t groupsX = (std::min)(groupsCount, maxWorkGroupsX);
+        uint32_t groupsZ = (groupsCount + groupsX - 1) / groupsX;
+
+        //The previous instance may still be drawn from the same buffer
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(followStrandsProgramID);
+        glUniform1i(followStrandsDrawIndexUniform, drawData.drawIndex);
+        glDispatchCompute(groupsX, 1, groupsZ);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    std::string Renderer::LoadShader(const char* name) const
+    {
+        return LoadShaderSource(name, shaderOverrideDirectory);
     }
 
     uint32_t Renderer::CreateGuidesVisualizationProgram()
     {
-        auto guidesVisualizationVertexShaderSource = LoadFile("hairglshaders/GuidesVisualization.vert");
-        auto guidesVisualizationFragmentShaderSource = LoadFile("hairglshaders/SimpleColor.frag");
-        uint32_t guidesVisualizationVertexShaderID = CompileShader(GLSLVersion, guidesVisualizationVertexShaderSource, GL_VERTEX_SHADER);
-        uint32_t guidesVisualizationFragmentShaderID = CompileShader(GLSLVersion, guidesVisualizationFragmentShaderSource, GL_FRAGMENT_SHADER);
-        return LinkProgram(guidesVisualizationVertexShaderID, guidesVisualizationFragmentShaderID);
+        return programCache.CreateProgram({
+            { GL_VERTEX_SHADER, GLSLVersion, LoadShader("GuidesVisualization.vert"), nullptr },
+            { GL_FRAGMENT_SHADER, GLSLVersion, LoadShader("SimpleColor.frag"), nullptr }
+        });
     }
 
     uint32_t Renderer::CreateGrowthMeshVisualizationProgram()
     {
-        auto growthMeshVisualizationVertexShaderSource = LoadFile("hairglshaders/GrowthMeshVisualization.vert");
-        auto growthMeshVisualizationFragmentShaderSource = LoadFile("hairglshaders/SimpleColor.frag");
-        uint32_t growthMeshVisualizationVertexShaderID = CompileShader(GLSLVersion, growthMeshVisualizationVertexShaderSource, GL_VERTEX_SHADER);
-        uint32_t growthMeshVisualizationFragmentShaderID = CompileShader(GLSLVersion, growthMeshVisualizationFragmentShaderSource, GL_FRAGMENT_SHADER);
-        return LinkProgram(growthMeshVisualizationVertexShaderID, growthMeshVisualizationFragmentShaderID);
+        return programCache.CreateProgram({
+            { GL_VERTEX_SHADER, GLSLVersion, LoadShader("GrowthMeshVisualization.vert"), nullptr },
+            { GL_FRAGMENT_SHADER, GLSLVersion, LoadShader("SimpleColor.frag"), nullptr }
+        });
     }
 
     uint32_t Renderer::CreateSimulationProgram()
     {
-        auto simulationShaderSource = LoadFile("hairglshaders/Simulation.comp");
-        uint32_t simulationShaderID = CompileShader(GLSLVersion, simulationShaderSource, GL_COMPUTE_SHADER, &shaderIncludeSrc);
-        return LinkProgram(simulationShaderID);
+        auto header = GLSLVersion + "#define SIMULATION_GROUP_SIZE " + std::to_string(simulationGroupSize) + "\n";
+        if (compactStorage) {
+            header += "#define COMPACT_STORAGE\n";
+        }
+        return programCache.CreateProgram({
+            { GL_COMPUTE_SHADER, header, LoadShader("Simulation.comp"), &shaderIncludeSrc }
+        });
+    }
+
+    uint32_t Renderer::CreateInteractionProgram(bool splat)
+    {
+        auto header = GLSLVersion + "#define INTERACTION_GROUP_SIZE " + std::to_string(InteractionGroupSize) + "\n";
+        if (splat) {
+            header += "#define SPLAT_PASS\n";
+        }
+        return programCache.CreateProgram({
+            { GL_COMPUTE_SHADER, header, LoadShader("HairInteraction.comp"), &shaderIncludeSrc }
+        });
+    }
+
+    uint32_t Renderer::CreateCullingProgram()
+    {
+        auto header = GLSLVersion + "#define CULLING_GROUP_SIZE " + std::to_string(CullingGroupSize) + "\n";
+        return programCache.CreateProgram({
+            { GL_COMPUTE_SHADER, header, LoadShader("Culling.comp"), &shaderIncludeSrc }
+        });
+    }
+
+    //Shaders evaluating strands read the follow strand cache when it is built
+    std::string Renderer::GetHairHeader() const
+    {
+        return followStrandsCache ? GLSLVersion + "#define FOLLOW_STRANDS_CACHE\n" : GLSLVersion;
     }
 
     uint32_t Renderer::CreateHairRenderingProgram()
     {
-        auto hairVertexShaderSource = LoadFile("hairglshaders/Hair.vert");
-        auto hairTessControlShaderSource = LoadFile("hairglshaders/Hair.tesc");
-        auto hairTessEvaluationShaderSource = LoadFile("hairglshaders/Hair.tese");
-        auto hairGeometrylShaderSource = LoadFile("hairglshaders/Hair.geom");
-        auto hairFragmentShaderSource = LoadFile("hairglshaders/Hair.frag");
-
-        uint32_t hairVertexShaderID = CompileShader(GLSLVersion, hairVertexShaderSource, GL_VERTEX_SHADER, &shaderIncludeSrc);
-        uint32_t hairTessControlShaderID = CompileShader(GLSLVersion, hairTessControlShaderSource, GL_TESS_CONTROL_SHADER, &shaderIncludeSrc);
-        uint32_t hairTessEvaluationShaderID = CompileShader(GLSLVersion, hairTessEvaluationShaderSource, GL_TESS_EVALUATION_SHADER, &shaderIncludeSrc);
-        uint32_t hairGeometryShaderID = CompileShader(GLSLVersion, hairGeometrylShaderSource, GL_GEOMETRY_SHADER, &shaderIncludeSrc);
-        uint32_t hairFragmentShaderID = CompileShader(GLSLVersion, hairFragmentShaderSource, GL_FRAGMENT_SHADER, &shaderIncludeSrc);
-
-        uint32_t programID = LinkProgram(hairVertexShaderID, hairTessControlShaderID, hairTessEvaluationShaderID, hairGeometryShaderID, hairFragmentShaderID);
-
-        glDeleteShader(hairVertexShaderID);
-        glDeleteShader(hairTessControlShaderID);
-        glDeleteShader(hairTessEvaluationShaderID);
-        glDeleteShader(hairGeometryShaderID);
-        glDeleteShader(hairFragmentShaderID);
-
-        return programID;
+        auto header = GetHairHeader();
+        return programCache.CreateProgram({
+            { GL_VERTEX_SHADER, GLSLVersion, LoadShader("Hair.vert"), &shaderIncludeSrc },
+            { GL_TESS_CONTROL_SHADER, header, LoadShader("Hair.tesc"), &hairIncludeSrc },
+            { GL_TESS_EVALUATION_SHADER, header, LoadShader("Hair.tese"), &hairIncludeSrc },
+            { GL_GEOMETRY_SHADER, GLSLVersion, LoadShader("Hair.geom"), &shaderIncludeSrc },
+            { GL_FRAGMENT_SHADER, GLSLVersion, LoadShader("Hair.frag"), &shaderIncludeSrc }
+        });
     }
 
-	Vector4 GetPyramidWindCorner(const Quaternion& rotationFromXToWind, const Vector3& axis, float angle, float magnitude)
-	{
-		Vector3 xAxis(1.0f, 0.0f, 0.0f);
-		Quaternion rotation(axis, angle);
-		auto side = rotationFromXToWind * rotation * xAxis * magnitude;
-		return Vector4(side.x, side.y, side.z, 0.0f);
-	}
-
-	Matrix4 Renderer::CreateWindPyramid(const Vector3& wind, int frame) const
-	{
-		float magnitude = wind.Length();
-		auto dir = wind / magnitude;
-		//magnitude *= (pow(sinf(frame * 0.00001f), 2.0f) + 0.5f);
-
-		Vector3 xAxis(1.0f, 0.0f, 0.0f);
-		auto rotationAxis = Vector3::Cross(xAxis, dir);
-		float angle = asin(rotationAxis.Length());
-
-		Quaternion rotationFromXToWind;
-		if (angle > 0.001)
-		{
-			rotationFromXToWind = Quaternion(rotationAxis.Normalized(), angle);
-		}
-
-		float coneAngle = 20.0f * DegToRad;
-
-		Matrix4 pyramid;
-		pyramid.m[0] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, 1, 0), coneAngle, magnitude);
-		pyramid.m[1] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, -1, 0), coneAngle, magnitude);
-		pyramid.m[2] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, 0, 1), coneAngle, magnitude);
-		pyramid.m[3] = GetPyramidWindCorner(rotationFromXToWind, Vector3(0, 0, -1), coneAngle, magnitude);
-
-		return pyramid;
-	}
+    uint32_t Renderer::CreateRibbonsComputeProgram()
+    {
+        auto header = GetHairHeader() + "#define RIBBON_GROUP_SIZE " + std::to_string(RibbonsGroupSize) + "\n";
+        return programCache.CreateProgram({
+            { GL_COMPUTE_SHADER, header, LoadShader("HairRibbons.comp"), &hairIncludeSrc }
+        });
+    }
+
+    uint32_t Renderer::CreateRibbonsRenderingProgram()
+    {
+        return programCache.CreateProgram({
+            { GL_VERTEX_SHADER, GLSLVersion, LoadShader("HairRibbons.vert"), &shaderIncludeSrc },
+            { GL_FRAGMENT_SHADER, GLSLVersion, LoadShader("Hair.frag"), &shaderIncludeSrc }
+        });
+    }
+
+    uint32_t Renderer::CreateFollowStrandsProgram()
+    {
+        auto header = GLSLVersion + "#define FOLLOW_STRANDS_GROUP_SIZE " + std::to_string(FollowStrandsGroupSize) + "\n";
+        return programCache.CreateProgram({
+            { GL_COMPUTE_SHADER, header, LoadShader("FollowStrands.comp"), &hairIncludeSrc }
+        });
+    }
 
     Renderer::~Renderer()
     {
@@ -259,6 +804,22 @@ namespace HairGL
         glDeleteProgram(guidesVisualizationProgramID);
         glDeleteProgram(hairRenderingProgramID);
         glDeleteProgram(simulationProgramID);
+        glDeleteProgram(interactionSplatProgramID);
+        glDeleteProgram(interactionApplyProgramID);
+        glDeleteProgram(cullingProgramID);
+        glDeleteProgram(ribbonsComputeProgramID);
+        glDeleteProgram(ribbonsRenderingProgramID);
+        glDeleteProgram(followStrandsProgramID);
         glDeleteVertexArrays(1, &emptyVertexArrayID);
+        glDeleteBuffers(1, &simulationSlotsBufferID);
+        glDeleteBuffers(1, &collidersBufferID);
+        glDeleteBuffers(1, &interactionGridBufferID);
+        glDeleteBuffers(1, &drawCommandsBufferID);
+        glDeleteBuffers(1, &visibleTrianglesBufferID);
+        glDeleteBuffers(1, &ribbonPointsBufferID);
+        glDeleteBuffers(1, &ribbonDrawCommandsBufferID);
+        glDeleteBuffers(1, &ribbonIndicesBufferID);
+        glDeleteBuffers(1, &followStrandsBufferID);
+        delete uniformRing;
     }
 }
\ No newline at end of file
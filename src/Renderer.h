@@ -2,39 +2,170 @@
 #define HAIRGL_RENDERER_H
 
 #include <stdint.h>
+#include <vector>
 #include <hairgl/Math.h>
 #include "Common.h"
+#include "gl/RingBuffer.h"
+#include "gl/ProgramCache.h"
+#include "FrameProfiler.h"
 
 namespace HairGL
 {
+    struct SimulationUniforms
+    {
+        int32_t firstInstance;
+        int32_t guidesCount;
+        int32_t verticesPerStrand;
+        int32_t strandsPerGroup;
+        int32_t timeStep;
+        int32_t gravity;
+        int32_t lengthConstraintIterations;
+        int32_t localShapeIterations;
+        int32_t restBoundsMin;
+        int32_t restBoundsSize;
+    };
+
+    struct InteractionUniforms
+    {
+        int32_t verticesCount;
+        int32_t gridResolution;
+        int32_t gridOrigin;
+        int32_t cellSize;
+        int32_t volumeStiffness;
+        int32_t hairFriction;
+    };
+
+    struct CullingUniforms
+    {
+        int32_t trianglesCount;
+        int32_t verticesPerStrand;
+        int32_t drawIndex;
+        int32_t visibleTrianglesOffset;
+        int32_t margin;
+        int32_t interpolationFactor;
+    };
+
+    struct RibbonsUniforms
+    {
+        int32_t drawIndex;
+        int32_t ribbonDrawIndex;
+        int32_t firstPatch;
+        int32_t patchesCount;
+        int32_t linesCount;
+        int32_t pointsPerLine;
+    };
+
+    //Ribbons of an instance are written and drawn in chunks of patches, so the buffer stays small
+    struct RibbonsLayout
+    {
+        uint32_t linesCount;
+        uint32_t pointsPerLine;
+        uint32_t patchesPerChunk;
+        uint32_t chunksCount;
+    };
+
+    //Where an instance finds its draw data after culling
+    struct InstanceDrawData
+    {
+        size_t drawIndex;
+        int32_t visibleTrianglesOffset;
+        size_t firstRibbonDraw;
+    };
+
+    struct VisualizationUniforms
+    {
+        int32_t viewProjectionMatrix;
+        int32_t doubleSegments;
+        int32_t verticesPerStrand;
+        int32_t color;
+    };
+
     class Renderer
     {
     public:
-        Renderer();
+        Renderer(FrameProfiler& profiler, const HairSystemSettings& settings);
         Renderer(const Renderer&) = delete;
-        void Simulate(HairInstance* instance, float timeStep) const;
-        void Render(const HairInstance* instance, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const;
+        void Simulate(HairInstance* const* instances, size_t count, float timeStep) const;
+        void Render(const HairInstance* const* instances, size_t count, const Matrix4& viewMatrix, const Matrix4& projectionMatrix) const;
         ~Renderer();
 
     private:
+        FrameProfiler& profiler;
         uint32_t emptyVertexArrayID;
 
         uint32_t guidesVisualizationProgramID;
         uint32_t growthMeshVisualizationProgramID;
         uint32_t simulationProgramID;
+        uint32_t interactionSplatProgramID;
+        uint32_t interactionApplyProgramID;
+        uint32_t cullingProgramID;
         uint32_t hairRenderingProgramID;
+        uint32_t ribbonsComputeProgramID;
+        uint32_t ribbonsRenderingProgramID;
+        uint32_t followStrandsProgramID;
+        HairRenderingPipeline renderingPipeline;
+        ProgramCache programCache;
+        std::string shaderOverrideDirectory;
+        bool compactStorage;
+        bool followStrandsCache;
+
+        RingBuffer* uniformRing;
+        uint32_t simulationSlotsBufferID;
+        uint32_t collidersBufferID;
+        uint32_t simulationGroupSize;
+        uint32_t maxWorkGroupsX;
+
+        uint32_t interactionGridResolution;
+        uint32_t interactionGridBufferID;
+        mutable bool interactionGridAllocated;
+
+        uint32_t drawCommandsBufferID;
+        uint32_t visibleTrianglesBufferID;
+        mutable size_t visibleTrianglesCapacity;
+
+        uint32_t ribbonPointsBufferID;
+        uint32_t ribbonDrawCommandsBufferID;
+        uint32_t ribbonIndicesBufferID;
+        mutable size_t ribbonPointsCapacity;
+        mutable size_t ribbonDrawCommandsCapacity;
+        mutable uint32_t ribbonIndicesLinesCount;
+        mutable uint32_t ribbonIndicesPointsPerLine;
+
+        uint32_t followStrandsBufferID;
+        mutable size_t followStrandsCapacity;
 
-        uint32_t hairDataBufferID;
-        uint32_t sceneDataBufferID;
-        uint32_t lightDataBufferID;
+        SimulationUniforms simulationUniforms;
+        InteractionUniforms interactionSplatUniforms;
+        InteractionUniforms interactionApplyUniforms;
+        CullingUniforms cullingUniforms;
+        RibbonsUniforms ribbonsUniforms;
+        int32_t ribbonsPointsPerPatchUniform;
+        int32_t followStrandsDrawIndexUniform;
+        VisualizationUniforms guidesVisualizationUniforms;
+        VisualizationUniforms growthMeshVisualizationUniforms;
 
+        std::string LoadShader(const char* name) const;
         uint32_t CreateGuidesVisualizationProgram();
         uint32_t CreateGrowthMeshVisualizationProgram();
         uint32_t CreateSimulationProgram();
+        uint32_t CreateInteractionProgram(bool splat);
+        uint32_t CreateCullingProgram();
         uint32_t CreateHairRenderingProgram();
-		Matrix4 CreateWindPyramid(const Vector3& wind, int frame) const;
+        uint32_t CreateRibbonsComputeProgram();
+        uint32_t CreateRibbonsRenderingProgram();
+        uint32_t CreateFollowStrandsProgram();
+        std::string GetHairHeader() const;
+        RibbonsLayout GetRibbonsLayout(const HairInstance* instance) const;
+        void CullInstances(const HairInstance* const* instances, size_t count, size_t sceneDataOffset, std::vector<InstanceDrawData>& drawData) const;
+        void RenderInstance(const HairInstance* instance, const Matrix4& viewProjectionMatrix, size_t sceneDataOffset, size_t lightDataOffset,
+            const InstanceDrawData& drawData) const;
+        void DrawRibbons(const HairInstance* instance, const InstanceDrawData& drawData) const;
+        void BuildFollowStrands(const HairInstance* instance, const InstanceDrawData& drawData) const;
+        void UpdateSimulationParams(HairInstance* const* instances, size_t count, float timeStep) const;
+        void ApplyHairInteraction(const HairInstance* instance) const;
 
         std::string shaderIncludeSrc;
+        std::string hairIncludeSrc;
     };
 }
 
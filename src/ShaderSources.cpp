@@ -0,0 +1,25 @@
+#include "ShaderSources.h"
+#include "Common.h"
+#include <stdexcept>
+#include <string.h>
+
+namespace HairGL
+{
+    std::string LoadShaderSource(const char* name, const std::string& overrideDirectory)
+    {
+        if (!overrideDirectory.empty()) {
+            std::string source;
+            if (TryLoadFile((overrideDirectory + "/" + name).c_str(), source)) {
+                return source;
+            }
+        }
+
+        for (size_t i = 0; i < EmbeddedShadersCount; i++) {
+            if (strcmp(EmbeddedShaders[i].name, name) == 0) {
+                return std::string(EmbeddedShaders[i].source, EmbeddedShaders[i].length);
+            }
+        }
+
+        throw std::runtime_error(std::string("Unknown shader ") + name);
+    }
+}
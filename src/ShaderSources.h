@@ -0,0 +1,25 @@
+#ifndef HAIRGL_SHADER_SOURCES_H
+#define HAIRGL_SHADER_SOURCES_H
+
+#include <stddef.h>
+#include <string>
+
+namespace HairGL
+{
+    //Shader files compiled into the library, the table is generated from src/shaders by the build
+    struct EmbeddedShader
+    {
+        const char* name;
+        const char* source;
+        size_t length;
+    };
+
+    extern const EmbeddedShader EmbeddedShaders[];
+    extern const size_t EmbeddedShadersCount;
+
+    //Source of a shader by its file name. Files in overrideDirectory take precedence over the
+    //embedded copy, so shaders can be edited without rebuilding the library.
+    std::string LoadShaderSource(const char* name, const std::string& overrideDirectory);
+}
+
+#endif
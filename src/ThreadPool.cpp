@@ -0,0 +1,139 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace HairGL
+{
+    ThreadPool::ThreadPool(uint32_t threadsCount) :
+        queuedTasksCount(0),
+        stopping(false)
+    {
+        uint32_t workersCount = threadsCount > 1 ? threadsCount - 1 : 0;
+
+        for (uint32_t i = 0; i < workersCount; i++) {
+            queues.push_back(new WorkQueue());
+        }
+
+        for (uint32_t i = 0; i < workersCount; i++) {
+            workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+        }
+    }
+
+    uint32_t ThreadPool::GetThreadsCount() const
+    {
+        return workers.size() + 1;
+    }
+
+    void ThreadPool::ParallelFor(uint32_t count, uint32_t grainSize, const RangeTask& task)
+    {
+        grainSize = (std::max)(grainSize, 1u);
+        uint32_t chunksCount = (count + grainSize - 1) / grainSize;
+
+        if (workers.empty() || chunksCount <= 1) {
+            if (count > 0) {
+                task(0, count);
+            }
+            return;
+        }
+
+        std::atomic<uint32_t> remainingChunksCount(chunksCount);
+
+        for (uint32_t i = 0; i < chunksCount; i++) {
+            uint32_t begin = i * grainSize;
+            uint32_t end = (std::min)(begin + grainSize, count);
+
+            Push(i % queues.size(), [this, &task, &remainingChunksCount, begin, end]() {
+                task(begin, end);
+                if (--remainingChunksCount == 0) {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    doneCondition.notify_all();
+                }
+            });
+        }
+
+        //The calling thread has no queue of its own and only steals
+        Task stolenTask;
+        while (remainingChunksCount > 0 && TryPop(queues.size(), stolenTask)) {
+            stolenTask();
+        }
+
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [&remainingChunksCount]() { return remainingChunksCount == 0; });
+    }
+
+    void ThreadPool::Push(uint32_t queueIndex, Task&& task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            queuedTasksCount++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+            queues[queueIndex]->tasks.push_back(std::move(task));
+        }
+
+        wakeCondition.notify_one();
+    }
+
+    bool ThreadPool::TryPop(uint32_t queueIndex, Task& task)
+    {
+        if (queueIndex < queues.size()) {
+            auto queue = queues[queueIndex];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (!queue->tasks.empty()) {
+                task = std::move(queue->tasks.front());
+                queue->tasks.pop_front();
+                queuedTasksCount--;
+                return true;
+            }
+        }
+
+        for (uint32_t i = 1; i <= queues.size(); i++) {
+            auto queue = queues[(queueIndex + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (!queue->tasks.empty()) {
+                task = std::move(queue->tasks.back());
+                queue->tasks.pop_back();
+                queuedTasksCount--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::WorkerLoop(uint32_t queueIndex)
+    {
+        Task task;
+        while (true) {
+            if (TryPop(queueIndex, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait(lock, [this]() { return stopping || queuedTasksCount > 0; });
+            if (stopping && queuedTasksCount == 0) {
+                return;
+            }
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (auto queue : queues) {
+            delete queue;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef HAIRGL_THREAD_POOL_H
+#define HAIRGL_THREAD_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace HairGL
+{
+    class ThreadPool
+    {
+    public:
+        typedef std::function<void()> Task;
+        typedef std::function<void(uint32_t begin, uint32_t end)> RangeTask;
+
+        explicit ThreadPool(uint32_t threadsCount = std::thread::hardware_concurrency());
+        ThreadPool(const ThreadPool&) = delete;
+        uint32_t GetThreadsCount() const;
+        void ParallelFor(uint32_t count, uint32_t grainSize, const RangeTask& task);
+        ~ThreadPool();
+
+    private:
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<WorkQueue*> queues;
+        std::atomic<uint32_t> queuedTasksCount;
+        std::mutex wakeMutex;
+        std::condition_variable wakeCondition;
+        std::mutex doneMutex;
+        std::condition_variable doneCondition;
+        bool stopping;
+
+        void Push(uint32_t queueIndex, Task&& task);
+        bool TryPop(uint32_t queueIndex, Task& task);
+        void WorkerLoop(uint32_t queueIndex);
+    };
+}
+
+#endif
@@ -54,12 +54,15 @@ namespace HairGL
         return shaderID;
     }
 
-    uint32_t LinkProgram(const uint32_t* shaderIDs, uint32_t stagesCount)
+    uint32_t LinkProgram(const uint32_t* shaderIDs, uint32_t stagesCount, bool retrievableBinary)
     {
         uint32_t programID = glCreateProgram();
         for (int i = 0; i < stagesCount; i++) {
             glAttachShader(programID, shaderIDs[i]);
         } 
+        if (retrievableBinary) {
+            glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
         glLinkProgram(programID);
 
         int linkStatus;
@@ -9,6 +9,7 @@ namespace HairGL
 {
     bool InitGL();
     uint32_t CompileShader(const std::string& version, const std::string& shaderSource, GLenum type, const std::string* includeSource = nullptr);
+    uint32_t LinkProgram(const uint32_t* shaderIDs, uint32_t stagesCount, bool retrievableBinary = false);
     uint32_t LinkProgram(uint32_t vertexShaderID, uint32_t tessControlShaderID, uint32_t tessEvaluationShaderID, uint32_t geometryShaderID, uint32_t fragmentShaderID);
     uint32_t LinkProgram(uint32_t vertexShaderID, uint32_t fragmentShaderID);
     uint32_t LinkProgram(uint32_t computeShaderID);
@@ -0,0 +1,178 @@
+#include "ProgramCache.h"
+#include "GLUtils.h"
+#include <algorithm>
+#include <stdio.h>
+
+namespace HairGL
+{
+    constexpr uint32_t ProgramBinaryMagic = 0x504C4748; //"HGLP"
+    constexpr uint32_t ProgramBinaryVersion = 1;
+
+    struct ProgramBinaryHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t driverIDLength;
+        uint32_t binaryLength;
+        uint32_t reserved;
+    };
+
+    //FNV-1a, the key only has to tell source and driver versions apart
+    void HashBytes(uint64_t& hash, const void* data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+    }
+
+    void HashString(uint64_t& hash, const std::string& str)
+    {
+        uint64_t length = str.length();
+        HashBytes(hash, &length, sizeof(length));
+        HashBytes(hash, str.data(), str.length());
+    }
+
+    ProgramCache::ProgramCache(const std::string& directory) :
+        directory(directory)
+    {
+        if (directory.empty()) {
+            return;
+        }
+
+        driverID = std::string((const char*)glGetString(GL_VENDOR)) + "\n" +
+            (const char*)glGetString(GL_RENDERER) + "\n" + (const char*)glGetString(GL_VERSION);
+
+        //Drivers without a disk cache of their own may report no binary formats at all
+        GLint formatsCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatsCount);
+        binaryFormats.resize(formatsCount);
+        if (formatsCount > 0) {
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, binaryFormats.data());
+        }
+    }
+
+    uint32_t ProgramCache::CreateProgram(const std::vector<ShaderStageSource>& stages) const
+    {
+        bool useCache = !directory.empty() && !binaryFormats.empty();
+        uint64_t key = 0;
+        if (useCache) {
+            key = GetKey(stages);
+            uint32_t programID = LoadProgram(key);
+            if (programID) {
+                return programID;
+            }
+        }
+
+        std::vector<uint32_t> shaderIDs;
+        for (auto& stage : stages) {
+            shaderIDs.push_back(CompileShader(stage.header, stage.source, stage.type, stage.includeSource));
+        }
+
+        uint32_t programID = LinkProgram(shaderIDs.data(), shaderIDs.size(), useCache);
+
+        for (auto shaderID : shaderIDs) {
+            glDeleteShader(shaderID);
+        }
+
+        if (useCache) {
+            StoreProgram(key, programID);
+        }
+
+        return programID;
+    }
+
+    uint64_t ProgramCache::GetKey(const std::vector<ShaderStageSource>& stages) const
+    {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        HashString(hash, driverID);
+        for (auto& stage : stages) {
+            uint32_t type = stage.type;
+            HashBytes(hash, &type, sizeof(type));
+            HashString(hash, stage.header);
+            HashString(hash, stage.includeSource ? *stage.includeSource : std::string());
+            HashString(hash, stage.source);
+        }
+        return hash;
+    }
+
+    std::string ProgramCache::GetPath(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.hglp", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    uint32_t ProgramCache::LoadProgram(uint64_t key) const
+    {
+        auto file = fopen(GetPath(key).c_str(), "rb");
+        if (!file) {
+            return 0;
+        }
+
+        ProgramBinaryHeader header;
+        std::string fileDriverID;
+        std::vector<uint8_t> binary;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == ProgramBinaryMagic &&
+            header.version == ProgramBinaryVersion && header.key == key && header.driverIDLength == driverID.length() &&
+            std::find(binaryFormats.begin(), binaryFormats.end(), (GLint)header.binaryFormat) != binaryFormats.end();
+
+        if (valid) {
+            fileDriverID.resize(header.driverIDLength);
+            binary.resize(header.binaryLength);
+            valid = fread(&fileDriverID[0], 1, fileDriverID.size(), file) == fileDriverID.size() && fileDriverID == driverID &&
+                fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        fclose(file);
+
+        if (!valid) {
+            return 0;
+        }
+
+        uint32_t programID = glCreateProgram();
+        glProgramBinary(programID, header.binaryFormat, binary.data(), binary.size());
+
+        int linkStatus;
+        glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+        if (linkStatus == GL_FALSE) {
+            glDeleteProgram(programID);
+            return 0;
+        }
+
+        return programID;
+    }
+
+    void ProgramCache::StoreProgram(uint64_t key, uint32_t programID) const
+    {
+        GLint binaryLength = 0;
+        glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+        if (binaryLength <= 0) {
+            return;
+        }
+
+        std::vector<uint8_t> binary(binaryLength);
+        GLenum binaryFormat;
+        glGetProgramBinary(programID, binaryLength, &binaryLength, &binaryFormat, binary.data());
+
+        ProgramBinaryHeader header = {};
+        header.magic = ProgramBinaryMagic;
+        header.version = ProgramBinaryVersion;
+        header.key = key;
+        header.binaryFormat = binaryFormat;
+        header.driverIDLength = driverID.length();
+        header.binaryLength = binaryLength;
+
+        //A partially written file is rejected by the length checks on load, so a failed write is harmless
+        auto file = fopen(GetPath(key).c_str(), "wb");
+        if (!file) {
+            return;
+        }
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(driverID.data(), 1, driverID.length(), file);
+        fwrite(binary.data(), 1, binaryLength, file);
+        fclose(file);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef HAIRGL_PROGRAM_CACHE_H
+#define HAIRGL_PROGRAM_CACHE_H
+
+#include "gl3w.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace HairGL
+{
+    struct ShaderStageSource
+    {
+        GLenum type;
+        std::string header;
+        std::string source;
+        const std::string* includeSource;
+    };
+
+    //Creates programs from source, keeping their binaries in a directory. A binary is found by a hash of
+    //the driver strings and all stage sources, and is compiled again whenever the driver rejects it.
+    class ProgramCache
+    {
+    public:
+        explicit ProgramCache(const std::string& directory);
+        ProgramCache(const ProgramCache&) = delete;
+        uint32_t CreateProgram(const std::vector<ShaderStageSource>& stages) const;
+
+    private:
+        std::string directory;
+        std::string driverID;
+        std::vector<GLint> binaryFormats;
+
+        uint64_t GetKey(const std::vector<ShaderStageSource>& stages) const;
+        std::string GetPath(uint64_t key) const;
+        uint32_t LoadProgram(uint64_t key) const;
+        void StoreProgram(uint64_t key, uint32_t programID) const;
+    };
+}
+
+#endif
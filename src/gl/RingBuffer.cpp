@@ -0,0 +1,159 @@
+#include "RingBuffer.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+namespace HairGL
+{
+    RingBuffer::RingBuffer(GLenum target, size_t size) :
+        target(target),
+        bufferID(0),
+        mappedData(nullptr),
+        capacity(0),
+        alignment(1),
+        head(0),
+        usedSize(0),
+        pendingSize(0)
+    {
+        int offsetAlignment = 0;
+        glGetIntegerv(target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        alignment = (std::max)(offsetAlignment, 1);
+
+        CreateBuffer(size);
+    }
+
+    void RingBuffer::CreateBuffer(size_t size)
+    {
+        capacity = size;
+        head = 0;
+        usedSize = 0;
+        pendingSize = 0;
+
+        glGenBuffers(1, &bufferID);
+        glBindBuffer(target, bufferID);
+
+        //Without buffer storage the ring is still used, but every write goes through glBufferSubData
+        if (glBufferStorage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, capacity, nullptr, flags);
+            mappedData = static_cast<uint8_t*>(glMapBufferRange(target, 0, capacity, flags));
+            if (mappedData == nullptr) {
+                throw std::runtime_error("Cannot map ring buffer.");
+            }
+        }
+        else {
+            glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+        }
+
+        glBindBuffer(target, 0);
+    }
+
+    void RingBuffer::DestroyBuffer()
+    {
+        for (auto& submission : submissions) {
+            glDeleteSync(submission.fence);
+        }
+        submissions.clear();
+
+        //Draws already issued keep the storage alive until they complete
+        if (mappedData) {
+            glBindBuffer(target, bufferID);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+            mappedData = nullptr;
+        }
+        glDeleteBuffers(1, &bufferID);
+        bufferID = 0;
+    }
+
+    void RingBuffer::WaitForOldestSubmission()
+    {
+        auto submission = submissions.front();
+        submissions.pop_front();
+
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            GLenum result = glClientWaitSync(submission.fence, flags, 1000000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+                break;
+            }
+            flags = 0;
+        }
+
+        glDeleteSync(submission.fence);
+        usedSize -= submission.size;
+    }
+
+    size_t RingBuffer::Align(size_t size) const
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void RingBuffer::Reserve(size_t frameSize)
+    {
+        //A frame can waste less than its own size when it wraps, so twice the frame size always fits
+        //and offsets written earlier in the frame stay valid
+        if (pendingSize == 0 && capacity < frameSize * 2) {
+            size_t newCapacity = (std::max)(capacity * 2, frameSize * 3);
+            DestroyBuffer();
+            CreateBuffer(newCapacity);
+        }
+    }
+
+    size_t RingBuffer::Write(const void* data, size_t size)
+    {
+        size_t alignedSize = Align(size);
+        size_t alignedHead = Align(head);
+        bool wraps = alignedHead + alignedSize > capacity;
+        size_t offset = wraps ? 0 : alignedHead;
+        size_t consumedSize = (wraps ? capacity : alignedHead) - head + alignedSize;
+
+        while (capacity - usedSize - pendingSize < consumedSize && !submissions.empty()) {
+            WaitForOldestSubmission();
+        }
+
+        if (capacity - usedSize - pendingSize < consumedSize) {
+            //Everything in the ring belongs to the frame being recorded, continue in a larger buffer
+            size_t newCapacity = (std::max)(capacity * 2, alignedSize * 4);
+            DestroyBuffer();
+            CreateBuffer(newCapacity);
+            offset = 0;
+            consumedSize = alignedSize;
+        }
+
+        if (mappedData) {
+            memcpy(mappedData + offset, data, size);
+        }
+        else {
+            glBindBuffer(target, bufferID);
+            glBufferSubData(target, offset, size, data);
+            glBindBuffer(target, 0);
+        }
+
+        head = offset + alignedSize;
+        pendingSize += consumedSize;
+
+        return offset;
+    }
+
+    void RingBuffer::Fence()
+    {
+        if (pendingSize == 0) {
+            return;
+        }
+
+        submissions.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), pendingSize });
+        usedSize += pendingSize;
+        pendingSize = 0;
+    }
+
+    uint32_t RingBuffer::GetBufferID() const
+    {
+        return bufferID;
+    }
+
+    RingBuffer::~RingBuffer()
+    {
+        DestroyBuffer();
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef HAIRGL_RING_BUFFER_H
+#define HAIRGL_RING_BUFFER_H
+
+#include "gl3w.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+
+namespace HairGL
+{
+    //Buffer that is written through a persistent mapping as a ring. Regions handed out
+    //since the last Fence call are reused only after the GPU has passed that fence.
+    class RingBuffer
+    {
+    public:
+        RingBuffer(GLenum target, size_t size);
+        RingBuffer(const RingBuffer&) = delete;
+        size_t Align(size_t size) const;
+        void Reserve(size_t frameSize);
+        size_t Write(const void* data, size_t size);
+        void Fence();
+        uint32_t GetBufferID() const;
+        ~RingBuffer();
+
+    private:
+        struct Submission
+        {
+            GLsync fence;
+            size_t size;
+        };
+
+        GLenum target;
+        uint32_t bufferID;
+        uint8_t* mappedData;
+        size_t capacity;
+        size_t alignment;
+        size_t head;
+        size_t usedSize;
+        size_t pendingSize;
+        std::deque<Submission> submissions;
+
+        void CreateBuffer(size_t size);
+        void DestroyBuffer();
+        void WaitForOldestSubmission();
+    };
+}
+
+#endif
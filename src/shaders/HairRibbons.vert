@@ -0,0 +1,30 @@
+layout (std140, binding = SCENE_DATA_BINDING) uniform SceneDataBlock {
+    SceneRenderData sceneData;
+};
+
+layout(std430, binding = RIBBON_POINTS_BINDING) readonly buffer RibbonPoints {
+    vec4 data[];
+} ribbonPoints;
+
+uniform int pointsPerPatch;
+
+layout(location = 0) out vec3 out_pos;
+layout(location = 1) out vec3 out_normal;
+layout(location = 2) out vec2 out_uv;
+
+void main()
+{
+    //One instance per patch, indices address the two sides of every point of the patch
+    int pointIndex = gl_InstanceID * pointsPerPatch + gl_VertexID / 2;
+	vec3 position = ribbonPoints.data[pointIndex * 2].xyz;
+	vec3 side = ribbonPoints.data[pointIndex * 2 + 1].xyz;
+	if((gl_VertexID & 1) != 0) {
+	    side = -side;
+	}
+
+	vec3 worldPosition = position + side;
+	out_pos = worldPosition;
+	out_uv = vec2(0.0, 0.0);
+	out_normal = length(side) > 0.0 ? normalize(side) : vec3(0.0);
+	gl_Position = sceneData.viewProjectionMatrix * vec4(worldPosition, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+//Strand interpolation shared by the tesselation pipeline and the compute ribbon pipeline
+
+layout (std140, binding = HAIR_DATA_BINDING) uniform HairDataBlock {
+    HairRenderData hairData;
+};
+
+layout (std140, binding = SCENE_DATA_BINDING) uniform SceneDataBlock {
+    SceneRenderData sceneData;
+};
+
+layout(std430, binding = POSITIONS_BUFFER_BINDING) readonly buffer Positions {
+    vec4 data[];
+} positions;
+
+layout(std430, binding = PREVIOUS_POSITIONS_BUFFER_BINDING) readonly buffer PreviousPositions {
+    vec4 data[];
+} previousPositions;
+
+layout(std430, binding = HAIR_INDICES_BUFFER_BINDING) readonly buffer HairIndices {
+    ivec4 data[];
+} hairIndices;
+
+layout(std430, binding = VISIBLE_TRIANGLES_BINDING) readonly buffer VisibleTriangles {
+    int data[];
+} visibleTriangles;
+
+#ifdef FOLLOW_STRANDS_CACHE
+//Strands interpolated by FollowStrands.comp this frame
+layout(std430, binding = FOLLOW_STRANDS_BINDING) readonly buffer FollowStrands {
+    vec4 data[];
+} followStrands;
+#endif
+
+struct HairLOD
+{
+    float density;
+    float tesselationFactor;
+    float widthScale;
+};
+
+vec3 getVertexPosition(int hairIndex, int vertexIndex)
+{
+    int index = hairIndex * (hairData.segmentsCount + 1) + clamp(vertexIndex, 0, hairData.segmentsCount);
+
+	//Simulation runs at a fixed step, strands are drawn between the last two steps
+	return mix(previousPositions.data[index].xyz, positions.data[index].xyz, hairData.interpolationFactor);
+}
+
+ivec3 getHairIndices(int triangleIndex)
+{
+	return hairIndices.data[triangleIndex].xyz;
+}
+
+//Patches are drawn only for the triangles that passed culling
+int getVisibleTriangle(int patchIndex)
+{
+    return visibleTriangles.data[hairData.visibleTrianglesOffset + patchIndex / hairData.segmentsCount];
+}
+
+//Size in pixels of the growth mesh triangle. Roots are used, so every segment grown from
+//the triangle picks the same level and strands do not change along their length.
+float getProjectedSize(int triangleIndex)
+{
+    ivec3 indices = getHairIndices(triangleIndex);
+	vec3 p0 = getVertexPosition(indices[0], 0);
+	vec3 p1 = getVertexPosition(indices[1], 0);
+	vec3 p2 = getVertexPosition(indices[2], 0);
+
+	vec3 center = (p0 + p1 + p2) / 3.0;
+	float extent = max(max(distance(p0, p1), distance(p1, p2)), distance(p2, p0));
+	float depth = max((sceneData.viewProjectionMatrix * vec4(center, 1.0)).w, 1e-4);
+	return extent * sceneData.projectionScale / depth * sceneData.viewportHeight * 0.5;
+}
+
+HairLOD getHairLOD(int triangleIndex)
+{
+    HairLOD lod = HairLOD(hairData.density, hairData.tesselationFactor, 1.0);
+
+	if(hairData.lodEnabled != 0) {
+	    float level = clamp(getProjectedSize(triangleIndex) / hairData.lodFullDetailSize, 0.0, 1.0);
+		lod.density = ceil(mix(min(hairData.lodMinDensity, hairData.density), hairData.density, level));
+		lod.tesselationFactor = mix(min(hairData.lodMinTesselationFactor, hairData.tesselationFactor), hairData.tesselationFactor, level);
+
+		//Isolines are always spaced evenly, so the strand count is the density rounded up
+		lod.widthScale = ceil(hairData.density) / max(lod.density, 1.0);
+	}
+
+	return lod;
+}
+
+vec3 getControlPoint(ivec3 hairIndices, int vertexIndex, vec3 weights)
+{
+    vec3 position = vec3(0, 0, 0);
+	position += getVertexPosition(hairIndices[0], vertexIndex) * weights[0];
+	position += getVertexPosition(hairIndices[1], vertexIndex) * weights[1];
+	position += getVertexPosition(hairIndices[2], vertexIndex) * weights[2];
+	return position;
+}
+
+float rand(vec2 co)
+{
+    return fract(sin(dot(co.xy ,vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+vec3 getBarycentricCoordinates(float lineCoordinate)
+{
+    float u = rand(vec2(lineCoordinate, 0.3));
+	float v = rand(vec2(lineCoordinate, -0.7));
+	if(u + v > 1.0)
+    {
+        u = 1.0 - u;
+        v = 1.0 - v;
+    }
+	return vec3(u, v, 1.0 - u - v);
+}
+
+//Strands a triangle grows at the given density, the isoline tesselator rounds it up
+int getLinesCount(float density)
+{
+    return int(ceil(max(density, 1.0)));
+}
+
+//Direction of the segment between two control points, zero for a degenerate one
+vec3 getSegmentTangent(vec3 bottom, vec3 top)
+{
+    vec3 segment = top - bottom;
+	return length(segment) == 0 ? vec3(0.0) : normalize(segment);
+}
+
+//Follow strand cache holds room for the full density of every visible triangle, a position and
+//a tangent per control point
+int getFollowStrandPoint(int visibleTriangle, int lineIndex, int vertexIndex)
+{
+    int verticesPerStrand = hairData.segmentsCount + 1;
+	int strandIndex = visibleTriangle * getLinesCount(hairData.density) + lineIndex;
+	return (strandIndex * verticesPerStrand + clamp(vertexIndex, 0, hairData.segmentsCount)) * 2;
+}
+
+//Point of a strand interpolated over the triangle, coordinate is the isoline tesselation coordinate:
+//x runs along the segment, y selects one of the linesCount strands
+void evaluateHairPoint(int patchIndex, int triangleIndex, int segmentIndex, vec2 coordinate, int linesCount, float widthScale, out vec3 position, out vec3 tangent, out float width)
+{
+#ifdef FOLLOW_STRANDS_CACHE
+	//Ribbons pad the strands the LOD drops with zero width ones, they reuse the last cached strand
+	int lineIndex = min(int(round(coordinate.y * linesCount)), linesCount - 1);
+	int firstPoint = getFollowStrandPoint(patchIndex / hairData.segmentsCount, lineIndex, 0);
+	int lastPoint = firstPoint + hairData.segmentsCount * 2;
+
+	vec3 p0 = followStrands.data[max(firstPoint + (segmentIndex - 1) * 2, firstPoint)].xyz;
+	vec3 p1 = followStrands.data[firstPoint + segmentIndex * 2].xyz;
+	vec3 p2 = followStrands.data[firstPoint + (segmentIndex + 1) * 2].xyz;
+	vec3 p3 = followStrands.data[min(firstPoint + (segmentIndex + 2) * 2, lastPoint)].xyz;
+	vec3 tangentBottom = followStrands.data[firstPoint + segmentIndex * 2 + 1].xyz;
+	vec3 tangentTop = followStrands.data[firstPoint + (segmentIndex + 1) * 2 + 1].xyz;
+#else
+	ivec3 hairIndices = getHairIndices(triangleIndex);
+	vec3 weights = getBarycentricCoordinates(coordinate.y);
+
+    vec3 p0 = getControlPoint(hairIndices, segmentIndex - 1, weights);
+	vec3 p1 = getControlPoint(hairIndices, segmentIndex, weights);
+	vec3 p2 = getControlPoint(hairIndices, segmentIndex + 1, weights);
+	vec3 p3 = getControlPoint(hairIndices, segmentIndex + 2, weights);
+	vec3 tangentBottom = getSegmentTangent(p1, p2);
+	vec3 tangentTop = getSegmentTangent(p2, p3);
+#endif
+
+	float u = coordinate.x;
+	float u2 = u * u;
+	float u3 = u2 * u;
+	vec4 uVec = vec4(u3, u2, u, 1) / 6.0;
+	mat4 coeffMatrix;
+	coeffMatrix[0] = vec4(-1, 3, -3, 1);
+	coeffMatrix[1] = vec4(3, -6, 0, 4);
+	coeffMatrix[2] = vec4(-3, 3, 3, 1);
+	coeffMatrix[3] = vec4(1, 0, 0, 0);
+	vec4 bVec = uVec * coeffMatrix;
+
+	position = p0 * bVec[0] + p1 * bVec[1] + p2 * bVec[2] + p3 * bVec[3];
+
+	float t = (segmentIndex + u) / hairData.segmentsCount - hairData.thinningStart;
+	t = clamp(t, 0.0, 1.0);
+	width = mix(hairData.rootWidth, hairData.tipWidth, t) * widthScale;
+
+	//The last segment has no segment above it
+	if(tangentTop == vec3(0.0))
+	{
+	    tangent = tangentBottom;
+	}
+	else 
+	{
+	    tangent = mix(tangentBottom, tangentTop, u);
+	}
+}
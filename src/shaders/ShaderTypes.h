@@ -20,6 +20,20 @@
 #define REF_VECTORS_BINDING 8
 #define GLOBAL_ROTATIONS_BINDING 9
 #define DEBUG_BUFFER_BINDING 10
+#define SIMULATION_PARAMS_BINDING 11
+#define SIMULATION_SLOTS_BINDING 12
+#define VISIBLE_TRIANGLES_BINDING 13
+#define DRAW_COMMANDS_BINDING 14
+#define RIBBON_POINTS_BINDING 15
+#define RIBBON_DRAW_COMMANDS_BINDING 16
+#define COLLIDERS_BINDING 17
+#define INTERACTION_GRID_BINDING 18
+#define FOLLOW_STRANDS_BINDING 19
+
+//Hair interaction cells hold a density and a velocity sum as fixed point, so integer atomics
+//accumulate them and the result does not depend on the order of the vertices
+#define INTERACTION_DENSITY_SCALE 4096.0
+#define INTERACTION_VELOCITY_SCALE 262144.0
 
 struct HairRenderData
 {
@@ -27,13 +41,13 @@ struct HairRenderData
     int segmentsCount;
     float tesselationFactor;
     float density;
-    float _padding0;
+    int visibleTrianglesOffset;
 
     //SHAPE
     float rootWidth;
     float tipWidth;
     float thinningStart;
-    float _padding1;
+    float interpolationFactor;
 
     //MATERIAL
     float specular;
@@ -41,13 +55,23 @@ struct HairRenderData
     float ambient;
     float specularPower;
     vec4 color;
+
+    //LOD
+    int lodEnabled;
+    float lodMinDensity;
+    float lodMinTesselationFactor;
+    float lodFullDetailSize;
 };
 
 struct SceneRenderData
 {
     mat4 viewProjectionMatrix;
     vec3 eyePosition;
+    float viewportHeight;
+    float projectionScale;
     float _padding0;
+    float _padding1;
+    float _padding2;
 };
 
 struct Light
@@ -66,4 +90,50 @@ struct LightRenderData
     int _padding2;
 };
 
+struct SimulationParams
+{
+    mat4 windPyramid;
+    float globalStiffness;
+    float localStiffness;
+    float damping;
+    int positionsOffset;
+};
+
+//Capsule from start to end, spheres have both ends at their center
+struct Collider
+{
+    vec3 start;
+    float radius;
+    vec3 end;
+    float _padding;
+};
+
+//Pool slot of an instance, the position buffer holding its current positions and its colliders
+struct SimulationSlot
+{
+    int poolSlot;
+    int positionsBuffer;
+    int firstCollider;
+    int collidersCount;
+};
+
+//Layout glDrawArraysIndirect reads
+struct DrawArraysIndirectCommand
+{
+    int count;
+    int instanceCount;
+    int first;
+    int baseInstance;
+};
+
+//Layout glDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+    int count;
+    int instanceCount;
+    int firstIndex;
+    int baseVertex;
+    int baseInstance;
+};
+
 #endif